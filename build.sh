@@ -12,10 +12,20 @@ if [ -n "${2+set}" ]; then
   RANGE="$1 $2"
 fi
 
+# the x86-64 baseline runs anywhere, hot kernels pick their CPU level
+# when they start, see include/cpu.h. ARCH=native ./build.sh for this
+# machine only.
+ARCH="${ARCH:-x86-64}"
+
 WARNINGS="-Wextra -Wall -Wshadow -Wstrict-aliasing -Wformat -Wformat-signedness"
-FLAGS="-std=c++11 -march=native -fno-exceptions -fomit-frame-pointer ${WARNINGS} -O3 -pedantic -pipe"
+FLAGS="-std=c++11 -march=${ARCH} -pthread -fno-exceptions -fomit-frame-pointer ${WARNINGS} -O3 -pedantic -pipe"
 # -Wconversion -fverbose-asm -save-temps -DNDEBUG
 
+# count allocations per profiled phase, see include/track_alloc.h
+if [ -n "${TRACK_ALLOC}" ]; then
+  FLAGS="${FLAGS} -DTRACK_ALLOC"
+fi
+
 mkdir -p out
 
 for i in `seq $RANGE`;
@@ -24,3 +34,11 @@ do
     echo "$COMMAND"
     ${COMMAND}
 done
+
+# tools, not days
+for TOOL in preload radix_bench report_compare;
+do
+    COMMAND="g++ ${FLAGS} ${INCLUDE} src/${TOOL}.cpp -o out/${TOOL}"
+    echo "$COMMAND"
+    ${COMMAND}
+done
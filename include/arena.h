@@ -0,0 +1,70 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bump allocator, everything it gave out is freed at once by destroy.
+// Memory comes in chunks of at least chunk_size bytes, chained so a
+// new chunk never moves what was already handed out.
+
+static const size_t ARENA_ALIGN = 16;
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+} ArenaChunk;
+
+typedef struct Arena {
+    void init(const size_t chunk_size);
+    void destroy();
+    void* alloc(const size_t size);
+    size_t allocated() const { return _allocated; }
+
+private:
+    ArenaChunk* _chunks;
+    char* _it;
+    char* _end;
+    size_t _chunk_size;
+    size_t _allocated;
+} Arena;
+
+void Arena::init(const size_t chunk_size) {
+    _chunks = NULL;
+    _it = NULL;
+    _end = NULL;
+    _chunk_size = chunk_size;
+    _allocated = 0;
+}
+
+void Arena::destroy() {
+    while (_chunks != NULL) {
+        ArenaChunk* next = _chunks->next;
+        free(_chunks);
+        _chunks = next;
+    }
+}
+
+// ARENA_ALIGN aligned, NULL if we're out of memory
+void* Arena::alloc(const size_t size) {
+    const size_t rounded = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if ((size_t) (_end - _it) < rounded) {
+        // the header is padded so data stays aligned
+        const size_t header = (sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+        const size_t size_chunk = (rounded > _chunk_size)? rounded : _chunk_size;
+        ArenaChunk* chunk = (ArenaChunk*) malloc(header + size_chunk);
+        if (chunk == NULL) return NULL;
+        chunk->next = _chunks;
+        chunk->size = size_chunk;
+        _chunks = chunk;
+        _it = (char*) chunk + header;
+        _end = _it + size_chunk;
+    }
+    void* p = _it;
+    _it += rounded;
+    _allocated += rounded;
+    return p;
+}
+
+#endif // ARENA_H
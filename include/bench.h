@@ -0,0 +1,166 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "profile.h"
+#include "radix_sort.h"
+#include "report.h"
+
+// Benchmark mode for the days, AOC_BENCH=N runs a day N more times in
+// the same process after a first normal run, and reports the spread.
+// A day's main becomes run(), bench_main calls it: every run goes
+// through the day's own init()/destroy(), so each starts from scratch.
+// Output of the timed runs is dropped, the profile table then covers
+// them only. AOC_BENCH_COLD=1 also drops the input from the page cache
+// before each run, so reads come from the disk.
+// Either way, AOC_REPORT then writes the record of the day, see report.h.
+
+static const uint32_t BENCH_MAX_RUNS = 1000000;
+
+typedef int (*DayMain)(int argc, char** argv);
+
+static uint32_t bench_runs() {
+    const char* env = getenv("AOC_BENCH");
+    if (env == NULL) return 0;
+    const long runs = strtol(env, NULL, 10);
+    if (runs <= 0) return 0;
+    return (runs > (long) BENCH_MAX_RUNS)? BENCH_MAX_RUNS : runs;
+}
+
+static bool bench_cold() {
+    const char* env = getenv("AOC_BENCH_COLD");
+    return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+// clean pages only, which an input we just read is
+static bool bench_drop_cache(const char* path) {
+    const int descriptor = open(path, O_RDONLY);
+    if (descriptor == -1) return false;
+    const bool ok = posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(descriptor);
+    return ok;
+}
+
+// nearest rank of sorted samples
+static uint64_t bench_percentile(const uint64_t* sorted, const size_t n, const uint32_t percent) {
+    size_t rank = (n * percent + 99) / 100;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1];
+}
+
+// samples are sorted in place
+static void bench_stats(uint64_t* samples, const size_t n, BenchStats& stats) {
+    radix_sort(samples, n);
+    stats.runs = n;
+    stats.min = samples[0];
+    stats.median = bench_percentile(samples, n, 50);
+    stats.p90 = bench_percentile(samples, n, 90);
+    stats.p99 = bench_percentile(samples, n, 99);
+    stats.max = samples[n - 1];
+
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += samples[i];
+    stats.mean = sum / n;
+    double squares = 0;
+    for (size_t i = 0; i < n; ++i) squares += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+    stats.stddev = (n > 1)? sqrt(squares / (n - 1)) : 0.0;
+}
+
+static uint64_t bench_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// run the day once with its output going nowhere, false if it failed
+static bool bench_quiet(DayMain run, int argc, char** argv, const int sink, uint64_t& ns) {
+    fflush(stdout);
+    const int saved = dup(STDOUT_FILENO);
+    if (saved == -1) return false;
+    dup2(sink, STDOUT_FILENO);
+
+    const uint64_t begin = bench_clock();
+    const int status = run(argc, argv);
+    ns = bench_clock() - begin;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return status == 0;
+}
+
+// what the record calls the day, "day7" for out/day7
+static const char* bench_day(const char* program) {
+    const char* slash = strrchr(program, '/');
+    return (slash == NULL)? program : slash + 1;
+}
+
+int bench_main(int argc, char** argv, DayMain run) {
+    // stdin can't be read twice
+    const bool from_file = argc > 1 && strcmp(argv[1], "-") != 0;
+    const uint32_t n_runs = from_file? bench_runs() : 0;
+
+    report_reset();
+    uint64_t ns = bench_clock();
+    const int status = run(argc, argv);
+    ns = bench_clock() - ns;
+    if (status != 0) return status;
+
+    if (n_runs == 0) {
+        if (!from_file) return 0;
+        BenchStats stats;
+        bench_stats(&ns, 1, stats);
+        if (!report_emit(bench_day(argv[0]), argv[1], stats)) printf("Couldn't write the report.\n");
+        return 0;
+    }
+
+    const bool cold = bench_cold();
+    uint64_t* samples = (uint64_t*) malloc(n_runs * sizeof(uint64_t));
+    const int sink = open("/dev/null", O_WRONLY);
+    if (samples == NULL || sink == -1) {
+        printf("Couldn't set up the benchmark.\n");
+        free(samples);
+        if (sink != -1) close(sink);
+        return -1;
+    }
+
+    profile_reset();
+    bool ok = true;
+    for (uint32_t i = 0; i < n_runs && ok; ++i) {
+        if (cold && !bench_drop_cache(argv[1])) {
+            printf("Couldn't drop %s from the page cache.\n", argv[1]);
+            ok = false;
+        }
+        report_reset();
+        if (ok && !bench_quiet(run, argc, argv, sink, samples[i])) {
+            printf("Run %u failed.\n", i + 1);
+            ok = false;
+        }
+    }
+    close(sink);
+
+    if (ok) {
+        BenchStats stats;
+        bench_stats(samples, n_runs, stats);
+        printf("Benchmark, %u %s runs in µs:\n", n_runs, cold? "cold" : "warm");
+        printf("min %.1f median %.1f p90 %.1f p99 %.1f max %.1f mean %.1f stddev %.1f\n",
+               stats.min / 1000.0, stats.median / 1000.0, stats.p90 / 1000.0, stats.p99 / 1000.0,
+               stats.max / 1000.0, stats.mean / 1000.0, stats.stddev / 1000.0);
+        profile_report();
+        if (!report_emit(bench_day(argv[0]), argv[1], stats)) printf("Couldn't write the report.\n");
+    }
+
+    free(samples);
+    return ok? 0 : -1;
+}
+
+#endif // BENCH_H
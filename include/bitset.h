@@ -1,7 +1,18 @@
 #ifndef BITSET_H
 #define BITSET_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "cpu.h"
 
 #define BIT_SET(a,b) ((a) |= (1ULL<<(b)))
 #define BIT_CLEAR(a,b) ((a) &= ~(1ULL<<(b)))
@@ -15,7 +26,7 @@
 #define BITMASK_CHECK_ANY(x,y) ((x) & (y))
 
 // TODO support more compilers
-int popcount32(uint32_t val) {
+CPU_DEFAULT int popcount32(uint32_t val) {
 #if defined(__GNUC__) || defined(__GNUG__)
     return __builtin_popcount(val);
 #else
@@ -26,4 +37,267 @@ int popcount32(uint32_t val) {
 #endif  
 }
 
+#ifdef CPU_DISPATCH
+// popcnt instead of a libgcc call
+CPU_V2 int popcount32(uint32_t val) {
+    return __builtin_popcount(val);
+}
+#endif
+
+// Bitset of any size, picked at runtime. Bits live in 64-bit words,
+// bit i is bit i % 64 of word i / 64. Words are 64 bytes aligned and
+// padded to whole 512-bit blocks plus at least one spare word, so the
+// SIMD loops have no tail and extract can always read the next word.
+// Bits past size() are always 0, counts and searches rely on it.
+// Whole bitset operations and counts are dispatched, see cpu.h.
+
+static const size_t BITSET_WORD_BITS = 64;
+static const size_t BITSET_BLOCK_WORDS = 8; // one 512-bit register
+static const size_t BITSET_ALIGNMENT = BITSET_BLOCK_WORDS * sizeof(uint64_t);
+
+typedef struct Bitset {
+    bool init(const size_t n_bits);
+    void destroy();
+
+    size_t size() const { return _n_bits; }
+    const uint64_t* words() const { return _words; }
+
+    bool get(const size_t i) const { return (_words[i >> 6] >> (i & 63)) & 1; }
+    void set(const size_t i) { _words[i >> 6] |= 1ULL << (i & 63); }
+    void clear(const size_t i) { _words[i >> 6] &= ~(1ULL << (i & 63)); }
+    void assign(const size_t i, const bool value);
+    void set_range(const size_t begin, const size_t end);
+    void fill() { set_range(0, _n_bits); }
+    void reset();
+    void swap(Bitset& other);
+
+    uint64_t extract(const size_t offset, const size_t n) const;
+
+    // other has to be the same size
+    void and_with(const Bitset& other);
+    void or_with(const Bitset& other);
+    void andnot_with(const Bitset& other); // this & ~other
+    void xor_with(const Bitset& other);
+
+    size_t count() const;
+    size_t count_and(const Bitset& other) const;
+
+    // size() when there's none
+    size_t find_first() const { return find_next(0); }
+    size_t find_next(const size_t i) const;
+    size_t rank(const size_t i) const;
+    size_t select(size_t k) const;
+
+private:
+    uint64_t* _words;
+    size_t _n_words;
+    size_t _n_bits;
+} Bitset;
+
+bool Bitset::init(const size_t n_bits) {
+    const size_t n_blocks = (n_bits / BITSET_WORD_BITS + 1 + BITSET_BLOCK_WORDS - 1) / BITSET_BLOCK_WORDS;
+    _n_words = n_blocks * BITSET_BLOCK_WORDS;
+    _n_bits = n_bits;
+    _words = (uint64_t*) aligned_alloc(BITSET_ALIGNMENT, _n_words * sizeof(uint64_t));
+    if (_words == NULL) return false;
+    reset();
+    return true;
+}
+
+void Bitset::destroy() {
+    free(_words);
+}
+
+void Bitset::reset() {
+    memset(_words, 0, _n_words * sizeof(uint64_t));
+}
+
+void Bitset::swap(Bitset& other) {
+    const Bitset tmp = *this;
+    *this = other;
+    other = tmp;
+}
+
+// no branch, pixels and such are random
+void Bitset::assign(const size_t i, const bool value) {
+    const uint64_t mask = 1ULL << (i & 63);
+    uint64_t& word = _words[i >> 6];
+    word = (word & ~mask) | (-(uint64_t) value & mask);
+}
+
+// bits in [begin, end)
+void Bitset::set_range(const size_t begin, const size_t end) {
+    if (begin >= end) return;
+    const size_t first = begin >> 6;
+    const size_t last = (end - 1) >> 6;
+    const uint64_t first_mask = ~0ULL << (begin & 63);
+    const uint64_t last_mask = ~0ULL >> (63 - ((end - 1) & 63));
+    if (first == last) {
+        _words[first] |= first_mask & last_mask;
+        return;
+    }
+    _words[first] |= first_mask;
+    for (size_t w = first + 1; w < last; ++w) _words[w] = ~0ULL;
+    _words[last] |= last_mask;
+}
+
+// n bits from offset, bit offset ends up as bit 0, n is 1 to 64
+// and offset + n is at most size()
+// inlined in the callers, their x86-64-v3 builds turn the mask into bzhi
+uint64_t Bitset::extract(const size_t offset, const size_t n) const {
+    const size_t w = offset >> 6;
+    const size_t shift = offset & 63;
+    // two shifts so a shift of 0 takes nothing from the next word
+    const uint64_t value = (_words[w] >> shift) | ((_words[w + 1] << 1) << (63 - shift));
+    return (n == BITSET_WORD_BITS)? value : value & ((1ULL << n) - 1);
+}
+
+enum BitsetOp { BITSET_AND, BITSET_OR, BITSET_ANDNOT, BITSET_XOR };
+
+// plain loops, every level gets its own vectorized build
+CPU_CLONES static void bitset_combine(uint64_t* a, const uint64_t* b, const size_t n_words, const BitsetOp op) {
+    switch (op) {
+        case BITSET_AND: for (size_t w = 0; w < n_words; ++w) a[w] &= b[w]; break;
+        case BITSET_OR: for (size_t w = 0; w < n_words; ++w) a[w] |= b[w]; break;
+        case BITSET_ANDNOT: for (size_t w = 0; w < n_words; ++w) a[w] &= ~b[w]; break;
+        case BITSET_XOR: for (size_t w = 0; w < n_words; ++w) a[w] ^= b[w]; break;
+    }
+}
+
+// bits set in a, or in a & b if b isn't NULL
+static inline size_t bitset_count_words(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    size_t count = 0;
+    if (b == NULL) {
+        for (size_t w = 0; w < n_words; ++w) count += __builtin_popcountll(a[w]);
+    } else {
+        for (size_t w = 0; w < n_words; ++w) count += __builtin_popcountll(a[w] & b[w]);
+    }
+    return count;
+}
+
+#ifdef CPU_DISPATCH
+// nibbles looked up with a shuffle, summed per 64 bits with sad, see Mula et al.
+CPU_TARGET_AVX2 static inline __m256i bitset_popcount_256(const __m256i x) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    const __m256i low = _mm256_and_si256(x, low_mask);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+CPU_TARGET_AVX2 static inline size_t bitset_count_256(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    __m256i sums = _mm256_setzero_si256();
+    for (size_t w = 0; w < n_words; w += 4) {
+        __m256i x = _mm256_load_si256((const __m256i*) (a + w));
+        if (b != NULL) x = _mm256_and_si256(x, _mm256_load_si256((const __m256i*) (b + w)));
+        sums = _mm256_add_epi64(sums, bitset_popcount_256(x));
+    }
+    return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+         + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+}
+
+// the same on 512 bits, vpopcntq isn't in every AVX-512 CPU
+CPU_TARGET_AVX512 static inline __m512i bitset_popcount_512(const __m512i x) {
+    const __m512i lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+    const __m512i low_mask = _mm512_set1_epi8(0x0F);
+    const __m512i low = _mm512_and_si512(x, low_mask);
+    const __m512i high = _mm512_and_si512(_mm512_srli_epi16(x, 4), low_mask);
+    const __m512i counts = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, low), _mm512_shuffle_epi8(lookup, high));
+    return _mm512_sad_epu8(counts, _mm512_setzero_si512());
+}
+
+CPU_TARGET_AVX512 static inline size_t bitset_count_512(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    __m512i sums = _mm512_setzero_si512();
+    for (size_t w = 0; w < n_words; w += 8) {
+        __m512i x = _mm512_load_si512((const void*) (a + w));
+        if (b != NULL) x = _mm512_and_si512(x, _mm512_load_si512((const void*) (b + w)));
+        sums = _mm512_add_epi64(sums, bitset_popcount_512(x));
+    }
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void*) lanes, sums);
+    size_t count = 0;
+    for (size_t i = 0; i < 8; ++i) count += lanes[i];
+    return count;
+}
+#endif
+
+CPU_DEFAULT static size_t bitset_count(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    return bitset_count_words(a, b, n_words);
+}
+
+#ifdef CPU_DISPATCH
+CPU_V2 static size_t bitset_count(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    return bitset_count_words(a, b, n_words);
+}
+
+CPU_V3 static size_t bitset_count(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    return bitset_count_256(a, b, n_words);
+}
+
+CPU_V4 static size_t bitset_count(const uint64_t* a, const uint64_t* b, const size_t n_words) {
+    return bitset_count_512(a, b, n_words);
+}
+#endif
+
+size_t Bitset::count() const { return bitset_count(_words, NULL, _n_words); }
+size_t Bitset::count_and(const Bitset& other) const { return bitset_count(_words, other._words, _n_words); }
+
+void Bitset::and_with(const Bitset& other) { bitset_combine(_words, other._words, _n_words, BITSET_AND); }
+void Bitset::or_with(const Bitset& other) { bitset_combine(_words, other._words, _n_words, BITSET_OR); }
+void Bitset::andnot_with(const Bitset& other) { bitset_combine(_words, other._words, _n_words, BITSET_ANDNOT); }
+void Bitset::xor_with(const Bitset& other) { bitset_combine(_words, other._words, _n_words, BITSET_XOR); }
+
+// first set bit at i or after
+size_t Bitset::find_next(const size_t i) const {
+    if (i >= _n_bits) return _n_bits;
+    size_t w = i >> 6;
+    uint64_t word = _words[w] & (~0ULL << (i & 63));
+    const size_t last = (_n_bits - 1) >> 6;
+    while (word == 0) {
+        if (w == last) return _n_bits;
+        word = _words[++w];
+    }
+    return (w << 6) + __builtin_ctzll(word);
+}
+
+// set bits before i
+// BETTER, keep a count per block if it's called in a loop
+size_t Bitset::rank(const size_t i) const {
+    const size_t end = (i > _n_bits)? _n_bits : i;
+    const size_t last = end >> 6;
+    size_t count = 0;
+    for (size_t w = 0; w < last; ++w) count += __builtin_popcountll(_words[w]);
+    if (end & 63) count += __builtin_popcountll(_words[last] & (~0ULL >> (64 - (end & 63))));
+    return count;
+}
+
+// index of the set bit of rank k in a word, k is below its popcount
+CPU_DEFAULT static size_t bitset_select_word(uint64_t word, size_t k) {
+    while (k-- > 0) word &= word - 1;
+    return __builtin_ctzll(word);
+}
+
+#ifdef CPU_DISPATCH
+CPU_V3 static size_t bitset_select_word(uint64_t word, size_t k) {
+    return __builtin_ctzll(_pdep_u64(1ULL << k, word));
+}
+#endif
+
+// index of the set bit of rank k, counting from 0
+size_t Bitset::select(size_t k) const {
+    const size_t n_words = (_n_bits + 63) >> 6;
+    for (size_t w = 0; w < n_words; ++w) {
+        const uint64_t word = _words[w];
+        const size_t n = __builtin_popcountll(word);
+        if (k >= n) {
+            k -= n;
+            continue;
+        }
+        return (w << 6) + bitset_select_word(word, k);
+    }
+    return _n_bits;
+}
+
 #endif //BITSET_H
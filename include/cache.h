@@ -0,0 +1,182 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Opt-in cache of parsed inputs, set AOC_CACHE=1 to use it.
+// The parsed structures are written as is in a sidecar next to the input
+// ("input/day4" -> "input/day4.cache") and later runs map it instead of
+// parsing the text again. The sidecar is only used if its format and
+// the day layout versions match, the input size and mtime didn't change
+// since it was written and the payload checksum is right.
+// Bump the version passed by a day whenever its cached structures change.
+
+static const uint32_t CACHE_MAGIC = 0x43434f41; // "AOCC"
+static const uint32_t CACHE_FORMAT = 1;
+static const size_t CACHE_PATH_MAX = 4096;
+
+typedef struct CacheHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t version;
+    uint32_t padding;
+    uint64_t input_size;
+    int64_t input_mtime_sec;
+    int64_t input_mtime_nsec;
+    uint64_t payload_size;
+    uint64_t checksum;
+    uint64_t reserved;
+} CacheHeader;
+
+// one piece of the payload, written back to back
+typedef struct CacheSection {
+    const void* data;
+    size_t size;
+} CacheSection;
+
+bool cache_enabled() {
+    const char* env = getenv("AOC_CACHE");
+    return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+// not meant to be secure, only to catch a torn or corrupted sidecar
+uint64_t cache_checksum(const void* data, const size_t size, uint64_t hash = 0xcbf29ce484222325) {
+    const unsigned char* p = (const unsigned char*) data;
+    size_t it = 0;
+    for (; it + 8 <= size; it += 8) {
+        uint64_t word;
+        memcpy(&word, p + it, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3;
+        hash ^= hash >> 29;
+    }
+    for (; it < size; ++it) hash = (hash ^ p[it]) * 0x100000001b3;
+    return hash;
+}
+
+static bool cache_path(const char* input, char* out) {
+    const int n = snprintf(out, CACHE_PATH_MAX, "%s.cache", input);
+    return n > 0 && (size_t) n < CACHE_PATH_MAX;
+}
+
+typedef struct Cache {
+    bool open(const char* input, const uint32_t version);
+    void close();
+    const char* data() const { return _map + sizeof(CacheHeader); }
+    size_t size() const { return _size - sizeof(CacheHeader); }
+
+private:
+    char* _map;
+    size_t _size;
+} Cache;
+
+// map the sidecar of input if there's a valid one
+bool Cache::open(const char* input, const uint32_t version) {
+    _map = NULL;
+    _size = 0;
+
+    char path[CACHE_PATH_MAX];
+    if (!cache_path(input, path)) return false;
+
+    struct stat input_stat;
+    if (stat(input, &input_stat) == -1) return false;
+
+    const int descriptor = ::open(path, O_RDONLY);
+    if (descriptor == -1) return false;
+
+    struct stat cache_stat;
+    if (fstat(descriptor, &cache_stat) == -1 || cache_stat.st_size < (off_t) sizeof(CacheHeader)) {
+        ::close(descriptor);
+        return false;
+    }
+
+    _size = cache_stat.st_size;
+    void* map = mmap(NULL, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, descriptor, 0);
+    ::close(descriptor);
+    if (map == MAP_FAILED) return false;
+    _map = (char*) map;
+
+    const CacheHeader* header = (const CacheHeader*) _map;
+    const bool valid = header->magic == CACHE_MAGIC &&
+                       header->format == CACHE_FORMAT &&
+                       header->version == version &&
+                       header->input_size == (uint64_t) input_stat.st_size &&
+                       header->input_mtime_sec == (int64_t) input_stat.st_mtim.tv_sec &&
+                       header->input_mtime_nsec == (int64_t) input_stat.st_mtim.tv_nsec &&
+                       header->payload_size == size() &&
+                       header->checksum == cache_checksum(data(), size());
+    if (valid) return true;
+
+    munmap(_map, _size);
+    _map = NULL;
+    return false;
+}
+
+void Cache::close() {
+    if (_map != NULL) munmap(_map, _size);
+}
+
+// Write the sidecar of input, through a temporary file renamed over
+// the old one so a reader never maps a half written cache.
+// Failing is fine, we'll parse the text again next time.
+bool cache_save(const char* input, const uint32_t version,
+                const CacheSection* sections, const size_t n_sections) {
+    char path[CACHE_PATH_MAX];
+    char temp[CACHE_PATH_MAX];
+    if (!cache_path(input, path)) return false;
+    const int n = snprintf(temp, CACHE_PATH_MAX, "%s.%d", path, (int) getpid());
+    if (n <= 0 || (size_t) n >= CACHE_PATH_MAX) return false;
+
+    struct stat input_stat;
+    if (stat(input, &input_stat) == -1) return false;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.format = CACHE_FORMAT;
+    header.version = version;
+    header.input_size = input_stat.st_size;
+    header.input_mtime_sec = input_stat.st_mtim.tv_sec;
+    header.input_mtime_nsec = input_stat.st_mtim.tv_nsec;
+
+    for (size_t i = 0; i < n_sections; ++i) header.payload_size += sections[i].size;
+
+    // put it together so the checksum doesn't depend on how it's split
+    const size_t total = sizeof(header) + header.payload_size;
+    char* buffer = (char*) malloc(total);
+    if (buffer == NULL) return false;
+    size_t offset = sizeof(header);
+    for (size_t i = 0; i < n_sections; ++i) {
+        memcpy(buffer + offset, sections[i].data, sections[i].size);
+        offset += sections[i].size;
+    }
+    header.checksum = cache_checksum(buffer + sizeof(header), header.payload_size);
+    memcpy(buffer, &header, sizeof(header));
+
+    bool ok = false;
+    const int descriptor = ::open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor != -1) {
+        size_t written = 0;
+        while (written < total) {
+            const ssize_t n_written = write(descriptor, buffer + written, total - written);
+            if (n_written < 0 && errno == EINTR) continue;
+            if (n_written <= 0) break;
+            written += n_written;
+        }
+        ::close(descriptor);
+        ok = (written == total) && rename(temp, path) == 0;
+        if (!ok) unlink(temp);
+    }
+
+    free(buffer);
+    return ok;
+}
+
+#endif // CACHE_H
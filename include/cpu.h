@@ -0,0 +1,52 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Hot kernels come in several versions, one per x86-64 level, and the
+// best one the CPU runs is picked once when the program starts (GCC
+// function multiversioning, through ifunc). The build itself only asks
+// for the x86-64 baseline, so the same binary runs anywhere.
+//   default    SSE2
+//   x86-64-v2  SSE4.2, popcnt
+//   x86-64-v3  AVX2, BMI2
+//   x86-64-v4  AVX-512
+//
+// Plain C++ loops take CPU_CLONES and the compiler builds every version.
+// Intrinsics take one definition per level, with the same name:
+//
+//   CPU_DEFAULT size_t count(...) { return count_with<Block16>(...); }
+//   #ifdef CPU_DISPATCH
+//   CPU_V3 size_t count(...) { return count_with<Block32>(...); }
+//   #endif
+//
+// The levels inline everything they call, so a generic loop written once
+// is built for each level, with blocks using CPU_TARGET_* intrinsics.
+// The x86-64-vN names need GCC 12, clang doesn't know them in target().
+// Without them or without ifunc, only the default version is there.
+
+#if defined(__GNUC__) && __GNUC__ >= 12 && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define CPU_DISPATCH 1
+#define CPU_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "arch=x86-64-v2", "default")))
+#define CPU_DEFAULT __attribute__((target("default"), flatten))
+#define CPU_V2 __attribute__((target("arch=x86-64-v2"), flatten))
+#define CPU_V3 __attribute__((target("arch=x86-64-v3"), flatten))
+#define CPU_V4 __attribute__((target("arch=x86-64-v4"), flatten))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+// TODO, older GCC, clang and MSVC could take a function pointer set from cpuid
+#define CPU_CLONES
+#define CPU_DEFAULT
+#endif
+
+// the level the dispatched kernels run at, for the profile
+static inline const char* cpu_level() {
+#ifdef CPU_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("x86-64-v4")) return "x86-64-v4";
+    if (__builtin_cpu_supports("x86-64-v3")) return "x86-64-v3";
+    if (__builtin_cpu_supports("x86-64-v2")) return "x86-64-v2";
+#endif
+    return "x86-64";
+}
+
+#endif // CPU_H
@@ -0,0 +1,102 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scan.h"
+#include "strtoint.h"
+
+// Bulk decoding of a comma separated list of small unsigned integers,
+// like 3,4,3,1,2. Commas and stray bytes are found a whole block at a
+// time with scan.h, then each field is converted from one 8 bytes load
+// with swar_digits.
+
+enum CsvStatus {
+    CSV_OK = 0,
+    CSV_FULL,     // out is full, it points to the next field
+    CSV_EMPTY,    // ",," or a trailing comma
+    CSV_INVALID,  // something else than a digit or a comma
+    CSV_OVERFLOW, // value doesn't fit the output type
+};
+
+// more digits than that can't come from swar_digits
+static const size_t CSV_MAX_DIGITS = 8;
+
+template <typename T>
+static inline CsvStatus csv_field(const char* field, const char* comma, const char* end,
+                                  T* out, const size_t max, size_t& count) {
+    const size_t length = comma - field;
+    if (length == 0) return CSV_EMPTY;
+    if (count == max) return CSV_FULL;
+    if (length > CSV_MAX_DIGITS) return CSV_OVERFLOW;
+
+    uint32_t value = 0;
+    if (end - field >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, field, sizeof(chunk));
+        value = swar_digits(chunk, length);
+    } else {
+        for (const char* d = field; d < comma; ++d) value = value * 10 + (*d - '0');
+    }
+    if (value > (uint32_t) (T) ~(T) 0) return CSV_OVERFLOW;
+    out[count++] = value;
+    return CSV_OK;
+}
+
+// Decode [it, end) in out, up to max values, count is how many we wrote.
+// it is moved to where we stopped: end when done, the next field when
+// out is full, the bad field or byte on error.
+template <typename T>
+CsvStatus decode_csv(const char*& it, const char* end, T* out, const size_t max, size_t& count) {
+    const char* field = it;
+    const char* p = it;
+    count = 0;
+    if (it == end) return CSV_OK;
+
+    CsvStatus status;
+    while ((size_t)(end - p) >= SCAN_WIDTH) {
+        const scan_mask commas = scan_block(p, ',');
+        const scan_mask invalid = ~(commas | scan_digits(p)) & SCAN_FULL;
+
+        // fields ending in this block, up to the first bad byte
+        scan_mask stop = commas;
+        if (invalid != 0) stop &= (invalid & (0 - invalid)) - 1;
+        while (stop != 0) {
+            const char* comma = p + __builtin_ctz(stop);
+            status = csv_field(field, comma, end, out, max, count);
+            if (status != CSV_OK) goto beach;
+            field = comma + 1;
+            stop &= stop - 1;
+        }
+        if (invalid != 0) {
+            it = p + __builtin_ctz(invalid);
+            return CSV_INVALID;
+        }
+        p += SCAN_WIDTH;
+    }
+
+    for (; p < end; ++p) {
+        if (*p == ',') {
+            status = csv_field(field, p, end, out, max, count);
+            if (status != CSV_OK) goto beach;
+            field = p + 1;
+        } else if (!ascii_isdigit(*p)) {
+            it = p;
+            return CSV_INVALID;
+        }
+    }
+
+    // last one, empty after a trailing comma
+    status = csv_field(field, end, end, out, max, count);
+    if (status != CSV_OK) goto beach;
+    it = end;
+    return CSV_OK;
+
+beach:
+    it = field;
+    return status;
+}
+
+#endif // CSV_H
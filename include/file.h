@@ -2,10 +2,23 @@
 #define FILE_H
 
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FILE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "scan.h"
+
 // TODO use _fstat and _open on Windows
 #ifdef _WIN32
 #error File.h not implemented for windows.
@@ -13,21 +26,48 @@
 
 static const int LINE_FEED = 10;
 
+// Below this size, one read() in a malloc'ed buffer is cheaper
+// than setting up and tearing down a mapping.
+static const off_t MMAP_THRESHOLD = 1 << 16;
+
+enum FileBackend { FILE_AUTO, FILE_READ, FILE_MMAP };
+
+// A line pointing inside the file buffer, without the line feed.
+// Not null terminated, only valid until the file is closed.
+typedef struct LineView {
+    const char* str;
+    size_t size;
+} LineView;
+
+struct File;
+
+// called by open_files for each file as soon as it's fully read
+typedef void (*FileReady)(const size_t index, struct File& file, void* user);
+
 typedef struct File {
-    bool open(const char* path);
+    bool open(const char* path, const FileBackend backend = FILE_AUTO);
     void close();
     off_t readline(char* out, const int buffer_size);
+    bool next_line(LineView& line);
+    off_t count_lines() const;
+    size_t line_starts(off_t* out, const size_t max) const;
+    void adopt(char* data, const off_t size);
     char* data() const { return _data; }
     off_t size() const { return _size; }
 
 private:
+    bool load(const int descriptor, const off_t size);
+    bool map(const int descriptor, const off_t size);
+
     char* _data;
     off_t _size;
     off_t _it;
+    bool _mapped;
 } File;
 
 void File::close() {
-    free(_data);
+    if (_mapped) munmap(_data, _size);
+    else free(_data);
 }
 
 // fill buffer until new line is encountered
@@ -36,26 +76,100 @@ off_t File::readline(char* out, const int buffer_size) {
     if (out == NULL) return 0;
     if (_it >= _size) return 0;
 
-    const off_t start = _it;
-    // we can be smarter by reading words or something
-    // but this is good enough for now
-    while (_it < _size && _data[_it] != LINE_FEED) {
-        if (_it - start >= buffer_size - 1) {
-            _it = start;
-            return 0;
+    const char* start = _data + _it;
+    const char* end = scan_byte(start, _data + _size, LINE_FEED);
+    const off_t length = end - start;
+    if (length >= buffer_size) return 0;
+
+    memcpy(out, start, length);
+    out[length] = '\0';
+
+    // go over the line ending
+    _it += length + 1;
+    return length + 1;
+}
+
+// zero copy version of readline
+// return false once we're past the last line
+bool File::next_line(LineView& line) {
+    if (_it >= _size) return false;
+
+    const char* start = _data + _it;
+    const char* end = scan_byte(start, _data + _size, LINE_FEED);
+    line.str = start;
+    line.size = end - start;
+
+    // go over the line ending
+    _it += line.size + 1;
+    return true;
+}
+
+off_t File::count_lines() const {
+    if (_size == 0) return 0;
+    const off_t n = count_byte(_data, _data + _size, LINE_FEED);
+    // last line might not have a line ending
+    return (_data[_size-1] == LINE_FEED)? n : n + 1;
+}
+
+// offset of the first char of every line, up to max of them
+// return how many were written
+size_t File::line_starts(off_t* out, const size_t max) const {
+    if (_size == 0 || max == 0) return 0;
+    out[0] = 0;
+    size_t n = 1 + scan_all(_data, _size, LINE_FEED, out + 1, max - 1);
+    // a trailing line feed doesn't start a new line
+    if (out[n-1] == _size) --n;
+    return n;
+}
+
+// read() is capped around 2GB per call on Linux, loop until we have it all
+bool File::load(const int descriptor, const off_t size) {
+    _data = (char*) malloc(size * sizeof(char));
+    if (_data == NULL) return false;
+
+    off_t total = 0;
+    while (total < size) {
+        const ssize_t n_read = pread(descriptor, _data + total, size - total, total);
+        if (n_read < 0 && errno == EINTR) continue;
+        if (n_read <= 0) {
+            free(_data);
+            return false;
         }
-        out[_it-start] = _data[_it];
-        ++_it;
+        total += n_read;
     }
-    const off_t n_read = _it - start + 1;
-    out[_it-start] = '\0';
+    _mapped = false;
+    return true;
+}
 
-    // go over the line ending
-    ++_it;
-    return n_read;
+// take ownership of a malloc'ed buffer holding the whole file
+void File::adopt(char* data, const off_t size) {
+    _data = data;
+    _size = size;
+    _it = 0;
+    _mapped = false;
 }
 
-bool File::open(const char* path) {
+// Private writable mapping so data() keeps handing out a char*,
+// pages are copied only if a solver writes to them.
+bool File::map(const int descriptor, const off_t size) {
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    // fault everything in now rather than one page at a time while parsing
+    flags |= MAP_POPULATE;
+#endif
+    void* address = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, descriptor, 0);
+    if (address == MAP_FAILED) return false;
+
+    // hints only, don't care if they fail
+    madvise(address, size, MADV_SEQUENTIAL);
+    madvise(address, size, MADV_WILLNEED);
+
+    _data = (char*) address;
+    _mapped = true;
+    return true;
+}
+
+bool File::open(const char* path, const FileBackend backend) {
     bool ok = false;
 
     int descriptor = ::open(path, O_RDONLY);
@@ -65,13 +179,12 @@ bool File::open(const char* path) {
     int status = fstat(descriptor, &buffer);
     if (status != 0) goto beach;
 
-    // TODO, check if using mmap directly is faster for big enough files
-    _data = (char*) malloc(buffer.st_size * sizeof(char));
-    if (_data == NULL) goto beach;
-
-    if(read(descriptor, _data, buffer.st_size)!= buffer.st_size) {
-        free(_data);
-        goto beach;
+    // can't map an empty file, fall back to read for those
+    if (buffer.st_size > 0 &&
+        (backend == FILE_MMAP || (backend == FILE_AUTO && buffer.st_size >= MMAP_THRESHOLD))) {
+        if (!map(descriptor, buffer.st_size)) goto beach;
+    } else {
+        if (!load(descriptor, buffer.st_size)) goto beach;
     }
 
     _size = buffer.st_size;
@@ -82,4 +195,311 @@ beach:
     return ok; 
 }
 
+#ifdef FILE_IO_URING
+
+// Just enough of io_uring to open, stat and read a list of files,
+// no need to pull liburing for that.
+typedef struct Uring {
+    bool init(const unsigned entries);
+    void destroy();
+    struct io_uring_sqe* get_sqe();
+    int submit_and_wait(const unsigned wait);
+    bool pop(struct io_uring_cqe* out);
+    unsigned entries() const { return _entries; }
+
+private:
+    int _descriptor;
+    unsigned _entries;
+    unsigned _sq_tail;
+    unsigned _submitted;
+
+    void* _sq_ring;
+    void* _cq_ring;
+    size_t _sq_ring_size;
+    size_t _cq_ring_size;
+
+    unsigned* _sq_head;
+    unsigned* _sq_tail_shared;
+    unsigned* _sq_mask;
+    unsigned* _sq_array;
+    struct io_uring_sqe* _sqes;
+
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned* _cq_mask;
+    struct io_uring_cqe* _cqes;
+} Uring;
+
+bool Uring::init(const unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    _descriptor = syscall(__NR_io_uring_setup, entries, &params);
+    if (_descriptor < 0) return false;
+
+    _entries = params.sq_entries;
+    _sq_tail = 0;
+    _submitted = 0;
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // both rings live in one mapping on 5.4+
+    const bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map) {
+        if (_cq_ring_size > _sq_ring_size) _sq_ring_size = _cq_ring_size;
+        _cq_ring_size = _sq_ring_size;
+    }
+
+    _sq_ring = mmap(NULL, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    _descriptor, IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED) goto beach;
+
+    if (single_map) {
+        _cq_ring = _sq_ring;
+    } else {
+        _cq_ring = mmap(NULL, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _descriptor, IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) {
+            munmap(_sq_ring, _sq_ring_size);
+            goto beach;
+        }
+    }
+
+    _sqes = (struct io_uring_sqe*) mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        _descriptor, IORING_OFF_SQES);
+    if (_sqes == MAP_FAILED) {
+        if (!single_map) munmap(_cq_ring, _cq_ring_size);
+        munmap(_sq_ring, _sq_ring_size);
+        goto beach;
+    }
+
+    _sq_head = (unsigned*) ((char*) _sq_ring + params.sq_off.head);
+    _sq_tail_shared = (unsigned*) ((char*) _sq_ring + params.sq_off.tail);
+    _sq_mask = (unsigned*) ((char*) _sq_ring + params.sq_off.ring_mask);
+    _sq_array = (unsigned*) ((char*) _sq_ring + params.sq_off.array);
+    _cq_head = (unsigned*) ((char*) _cq_ring + params.cq_off.head);
+    _cq_tail = (unsigned*) ((char*) _cq_ring + params.cq_off.tail);
+    _cq_mask = (unsigned*) ((char*) _cq_ring + params.cq_off.ring_mask);
+    _cqes = (struct io_uring_cqe*) ((char*) _cq_ring + params.cq_off.cqes);
+    return true;
+
+beach:
+    ::close(_descriptor);
+    return false;
+}
+
+void Uring::destroy() {
+    munmap(_sqes, _entries * sizeof(struct io_uring_sqe));
+    if (_cq_ring != _sq_ring) munmap(_cq_ring, _cq_ring_size);
+    munmap(_sq_ring, _sq_ring_size);
+    ::close(_descriptor);
+}
+
+// NULL if the submission ring is full
+struct io_uring_sqe* Uring::get_sqe() {
+    const unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (_sq_tail - head >= _entries) return NULL;
+
+    const unsigned index = _sq_tail & *_sq_mask;
+    struct io_uring_sqe* sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    _sq_array[index] = index;
+    ++_sq_tail;
+    return sqe;
+}
+
+int Uring::submit_and_wait(const unsigned wait) {
+    __atomic_store_n(_sq_tail_shared, _sq_tail, __ATOMIC_RELEASE);
+    while (true) {
+        const int ret = syscall(__NR_io_uring_enter, _descriptor, _sq_tail - _submitted, wait,
+                                IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret > 0) _submitted += ret;
+        return ret;
+    }
+}
+
+bool Uring::pop(struct io_uring_cqe* out) {
+    const unsigned head = *_cq_head;
+    if (head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) return false;
+    *out = _cqes[head & *_cq_mask];
+    __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// what we know of a file while its open, stat and reads are in flight
+typedef struct Pending {
+    struct statx stat;
+    char* data;
+    off_t size;
+    off_t done;
+    int descriptor;
+    uint8_t waiting; // open and statx not completed yet
+    bool failed;
+} Pending;
+
+enum UringOp { URING_OPEN, URING_STAT, URING_READ };
+
+// one read can't go over 4GB, stay well under
+static const off_t URING_READ_MAX = 1 << 30;
+
+static void uring_read(Uring& ring, Pending& pending, const size_t index) {
+    struct io_uring_sqe* sqe = ring.get_sqe();
+    const off_t left = pending.size - pending.done;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = pending.descriptor;
+    sqe->addr = (uint64_t) (uintptr_t) (pending.data + pending.done);
+    sqe->len = (left > URING_READ_MAX)? URING_READ_MAX : left;
+    sqe->off = pending.done;
+    sqe->user_data = (index << 2) | URING_READ;
+}
+
+// Opens, stats and reads all files through one ring, so the kernel sees
+// every request at once instead of one blocking syscall after the other.
+// Files it couldn't load are left for the fallback.
+static size_t uring_open_files(const char* const* paths, const size_t n, File* files,
+                               bool* loaded, FileReady ready, void* user) {
+    unsigned entries = 2;
+    while (entries < 2 * n && entries < 256) entries <<= 1;
+
+    Uring ring;
+    if (!ring.init(entries)) return 0;
+
+    Pending* pending = (Pending*) calloc(n, sizeof(Pending));
+    if (pending == NULL) {
+        ring.destroy();
+        return 0;
+    }
+    // what cleanup looks at, for files never submitted too
+    for (size_t i = 0; i < n; ++i) pending[i].descriptor = -1;
+
+    size_t n_loaded = 0;
+    size_t next = 0;
+    unsigned in_flight = 0;
+    while (next < n || in_flight > 0) {
+        // an open and a stat per file, reads reuse the slots those free
+        while (next < n && in_flight + 2 <= ring.entries()) {
+            Pending& p = pending[next];
+            p.descriptor = -1;
+            p.waiting = 2;
+
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t) (uintptr_t) paths[next];
+            sqe->open_flags = O_RDONLY;
+            sqe->user_data = (next << 2) | URING_OPEN;
+
+            sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t) (uintptr_t) paths[next];
+            sqe->len = STATX_SIZE;
+            sqe->off = (uint64_t) (uintptr_t) &p.stat;
+            sqe->user_data = (next << 2) | URING_STAT;
+
+            in_flight += 2;
+            ++next;
+        }
+
+        if (ring.submit_and_wait(1) < 0) break;
+
+        struct io_uring_cqe cqe;
+        while (ring.pop(&cqe)) {
+            --in_flight;
+            const size_t index = cqe.user_data >> 2;
+            Pending& p = pending[index];
+
+            switch (cqe.user_data & 3) {
+                case URING_OPEN:
+                    if (cqe.res < 0) p.failed = true;
+                    else p.descriptor = cqe.res;
+                    --p.waiting;
+                    break;
+                case URING_STAT:
+                    if (cqe.res < 0) p.failed = true;
+                    else p.size = p.stat.stx_size;
+                    --p.waiting;
+                    break;
+                case URING_READ:
+                    if (cqe.res <= 0) {
+                        p.failed = true;
+                        break;
+                    }
+                    p.done += cqe.res;
+                    if (p.done < p.size) {
+                        uring_read(ring, p, index);
+                        ++in_flight;
+                        continue;
+                    }
+                    break;
+            }
+            if (p.waiting > 0) continue;
+
+            // both open and stat are back, start reading
+            if (!p.failed && p.data == NULL && p.size > 0) {
+                p.data = (char*) malloc(p.size);
+                if (p.data != NULL) {
+                    uring_read(ring, p, index);
+                    ++in_flight;
+                    continue;
+                }
+                p.failed = true;
+            }
+
+            if (p.descriptor >= 0) ::close(p.descriptor);
+            p.descriptor = -1;
+            if (p.failed) {
+                free(p.data);
+                p.data = NULL;
+                continue;
+            }
+
+            files[index].adopt(p.data, p.size);
+            p.data = NULL;
+            loaded[index] = true;
+            ++n_loaded;
+            if (ready != NULL) ready(index, files[index], user);
+        }
+    }
+
+    // Only left over if the ring itself broke down. The ring goes first,
+    // the kernel may still have a statx or a read into pending in flight.
+    ring.destroy();
+    for (size_t i = 0; i < n; ++i) {
+        if (pending[i].descriptor >= 0) ::close(pending[i].descriptor);
+        free(pending[i].data);
+    }
+    free(pending);
+    return n_loaded;
+}
+
+#endif // FILE_IO_URING
+
+// Load a list of files, handing each one to ready as soon as it's in memory.
+// Uses one io_uring for the whole list when we have it, then plain pread
+// for anything it couldn't do (no io_uring, old kernel, ...).
+// Files that can't be read are never handed out.
+// Return how many were loaded.
+size_t open_files(const char* const* paths, const size_t n, File* files, FileReady ready, void* user) {
+    if (n == 0) return 0;
+    bool* loaded = (bool*) calloc(n, sizeof(bool));
+    if (loaded == NULL) return 0;
+
+    size_t n_loaded = 0;
+#ifdef FILE_IO_URING
+    n_loaded = uring_open_files(paths, n, files, loaded, ready, user);
+#endif
+
+    for (size_t i = 0; i < n && n_loaded < n; ++i) {
+        if (loaded[i]) continue;
+        if (!files[i].open(paths[i], FILE_READ)) continue;
+        ++n_loaded;
+        if (ready != NULL) ready(i, files[i], user);
+    }
+
+    free(loaded);
+    return n_loaded;
+}
+
 #endif // FILE_H
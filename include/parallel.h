@@ -0,0 +1,256 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "scan.h"
+#include "stream.h"
+
+// Parse line independent inputs on several threads.
+// Lines are indexed once over the whole file buffer, split in ranges of
+// about the same number of bytes, and each thread runs the parse callback
+// on its range with its own accumulator. Merging the accumulators is left
+// to the caller once parse_lines returns.
+// Pipes, stdin and files too big to load go through parse_stream, which
+// copies the lines of a Stream in batches and parses each batch the same
+// way, so memory stays at one batch and its index.
+
+// below this many lines per thread, starting one isn't worth it
+static const size_t PARALLEL_MIN_LINES = 1 << 14;
+static const size_t PARALLEL_MAX_THREADS = 64;
+// a batch of streamed lines, and the largest file we load whole
+static const size_t PARALLEL_BATCH = 1 << 24;
+static const off_t PARALLEL_LOAD_MAX = (off_t) 1 << 30;
+
+// index is the line number in the file, local the accumulator of the thread
+typedef bool (*ParseLine)(const LineView& line, const size_t index, void* local, void* user);
+
+typedef struct Lines {
+    bool init(const File& file) { return init(file.data(), file.size()); }
+    bool init(const char* data, const off_t size);
+    void destroy();
+    size_t count() const { return _n; }
+    LineView line(const size_t index) const;
+    off_t start(const size_t index) const { return _starts[index]; }
+
+private:
+    const char* _data;
+    off_t _size;
+    off_t* _starts;
+    size_t _n;
+} Lines;
+
+// offset of every line start, grown as we go to stay in one pass
+bool Lines::init(const char* data, const off_t size) {
+    _data = data;
+    _size = size;
+    _n = 0;
+
+    size_t capacity = 1024;
+    _starts = (off_t*) malloc(capacity * sizeof(off_t));
+    if (_starts == NULL) return false;
+    if (_size == 0) return true;
+
+    _starts[_n++] = 0;
+    off_t base = 0;
+    while (true) {
+        const size_t found = scan_all(_data + base, _size - base, LINE_FEED,
+                                      _starts + _n, capacity - _n);
+        for (size_t i = _n; i < _n + found; ++i) _starts[i] += base;
+        _n += found;
+        if (_n < capacity) break;
+
+        // full, keep going after the last one found
+        base = _starts[_n - 1];
+        capacity *= 2;
+        off_t* starts = (off_t*) realloc(_starts, capacity * sizeof(off_t));
+        if (starts == NULL) {
+            free(_starts);
+            return false;
+        }
+        _starts = starts;
+    }
+
+    // a trailing line feed doesn't start a new line
+    if (_starts[_n - 1] == _size) --_n;
+    return true;
+}
+
+void Lines::destroy() {
+    free(_starts);
+}
+
+// without the line feed
+LineView Lines::line(const size_t index) const {
+    LineView line;
+    line.str = _data + _starts[index];
+    const off_t end = (index + 1 < _n)? _starts[index + 1] - 1 : _size;
+    line.size = end - _starts[index];
+    // last line might still have its line feed
+    if (line.size > 0 && line.str[line.size - 1] == LINE_FEED) --line.size;
+    return line;
+}
+
+typedef struct LineRange {
+    const Lines* lines;
+    size_t first; // index of the first line of lines in the input
+    size_t begin;
+    size_t end;
+    ParseLine parse;
+    void* local;
+    void* user;
+    bool* failed;
+} LineRange;
+
+static void* parse_range(void* arg) {
+    const LineRange* range = (const LineRange*) arg;
+    for (size_t i = range->begin; i < range->end; ++i) {
+        if (!range->parse(range->lines->line(i), range->first + i, range->local, range->user)) {
+            __atomic_store_n(range->failed, true, __ATOMIC_RELAXED);
+            break;
+        }
+        // someone else failed, no need to finish
+        if ((i & 1023) == 0 && __atomic_load_n(range->failed, __ATOMIC_RELAXED)) break;
+    }
+    return NULL;
+}
+
+// number of threads parse_lines would use, to size the accumulators
+size_t parse_threads(const Lines& lines, size_t n_threads = 0) {
+    if (n_threads == 0) {
+        const long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n_cpu > 0)? n_cpu : 1;
+    }
+    if (n_threads > PARALLEL_MAX_THREADS) n_threads = PARALLEL_MAX_THREADS;
+    const size_t n_max = lines.count() / PARALLEL_MIN_LINES;
+    if (n_threads > n_max) n_threads = n_max;
+    return (n_threads > 0)? n_threads : 1;
+}
+
+// Accumulators are n_threads slots of local_size bytes starting at locals,
+// thread t gets locals + t * local_size. The calling thread takes the
+// first range. Fails if any parse call failed.
+// first is added to the index parse gets, for lines that aren't the
+// start of the input.
+bool parse_lines(const Lines& lines, const size_t n_threads, ParseLine parse,
+                 void* locals, const size_t local_size, void* user, const size_t first = 0) {
+    LineRange ranges[PARALLEL_MAX_THREADS];
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS];
+    bool failed = false;
+
+    const size_t n = lines.count();
+    const size_t n_ranges = (n_threads == 0)? 1 :
+                            (n_threads > PARALLEL_MAX_THREADS)? PARALLEL_MAX_THREADS : n_threads;
+
+    // split by bytes, lines don't all have the same length
+    const off_t total = (n > 0)? lines.start(n - 1) : 0;
+    size_t begin = 0;
+    for (size_t t = 0; t < n_ranges; ++t) {
+        size_t end = n;
+        if (t + 1 < n_ranges) {
+            // first line starting at or after our share of the bytes
+            const off_t target = total / n_ranges * (t + 1);
+            size_t low = begin, high = n;
+            while (low < high) {
+                const size_t mid = low + (high - low) / 2;
+                if (lines.start(mid) < target) low = mid + 1;
+                else high = mid;
+            }
+            end = low;
+        }
+
+        ranges[t].lines = &lines;
+        ranges[t].first = first;
+        ranges[t].begin = begin;
+        ranges[t].end = end;
+        ranges[t].parse = parse;
+        ranges[t].local = (char*) locals + t * local_size;
+        ranges[t].user = user;
+        ranges[t].failed = &failed;
+        begin = end;
+    }
+
+    // if a thread can't start, its range is done here after ours
+    for (size_t t = 1; t < n_ranges; ++t) {
+        started[t] = (pthread_create(&threads[t], NULL, parse_range, &ranges[t]) == 0);
+    }
+    parse_range(&ranges[0]);
+    for (size_t t = 1; t < n_ranges; ++t) {
+        if (started[t]) pthread_join(threads[t], NULL);
+        else parse_range(&ranges[t]);
+    }
+
+    return !failed;
+}
+
+// regular files up to PARALLEL_LOAD_MAX, everything else is streamed
+bool parse_loads_whole(const char* path) {
+    if (strcmp(path, "-") == 0) return false;
+    struct stat path_stat;
+    if (stat(path, &path_stat) != 0) return false;
+    return S_ISREG(path_stat.st_mode) && path_stat.st_size <= PARALLEL_LOAD_MAX;
+}
+
+// threads parse_stream might use, to size the accumulators
+size_t parse_stream_threads() {
+    const long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpu <= 0) return 1;
+    return ((size_t) n_cpu > PARALLEL_MAX_THREADS)? PARALLEL_MAX_THREADS : n_cpu;
+}
+
+static bool parse_batch(const char* batch, const size_t size, const size_t n_threads, ParseLine parse,
+                        void* locals, const size_t local_size, void* user, size_t& first) {
+    Lines lines;
+    if (!lines.init(batch, size)) return false;
+    const bool ok = parse_lines(lines, parse_threads(lines, n_threads), parse, locals, local_size, user, first);
+    first += lines.count();
+    lines.destroy();
+    return ok;
+}
+
+// Like parse_lines on what's left of stream, with n_threads accumulators
+// from parse_stream_threads. A batch may use fewer of them.
+// Fails if a parse call failed, the stream broke or we ran out of memory.
+bool parse_stream(Stream& stream, const size_t n_threads, ParseLine parse,
+                  void* locals, const size_t local_size, void* user) {
+    size_t capacity = PARALLEL_BATCH;
+    char* batch = (char*) malloc(capacity);
+    if (batch == NULL) return false;
+
+    size_t size = 0;
+    size_t first = 0;
+    bool ok = true;
+    LineView line;
+    while (ok && stream.next_line(line)) {
+        if (size > 0 && size + line.size + 1 > capacity) {
+            ok = parse_batch(batch, size, n_threads, parse, locals, local_size, user, first);
+            size = 0;
+            if (!ok) break;
+        }
+        // a line longer than a batch gets one of its own
+        if (line.size + 1 > capacity) {
+            char* bigger = (char*) realloc(batch, line.size + 1);
+            if (bigger == NULL) {
+                ok = false;
+                break;
+            }
+            batch = bigger;
+            capacity = line.size + 1;
+        }
+        memcpy(batch + size, line.str, line.size);
+        size += line.size;
+        batch[size++] = LINE_FEED;
+    }
+    if (ok && size > 0) ok = parse_batch(batch, size, n_threads, parse, locals, local_size, user, first);
+
+    free(batch);
+    return ok && !stream.failed();
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,134 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Hardware counters of this process through perf_event_open, Linux only.
+// Each counter is opened on its own, user space only, and counts threads
+// started after it was opened too. A counter the CPU, the VM or
+// perf_event_paranoid doesn't allow is left out, the others still work.
+// Counters the kernel had to multiplex are scaled up to the full time.
+
+enum PerfCounter {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTERS,
+};
+
+static const char* const PERF_NAMES[PERF_COUNTERS] = {
+    "cycles", "instr", "L1D miss", "LLC miss", "br miss", "dTLB miss", "faults",
+};
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+typedef struct Perf {
+    bool init();
+    void destroy();
+    bool available(const PerfCounter counter) const { return _fds[counter] != -1; }
+    size_t count() const { return _n_open; }
+    int error() const { return _error; }
+    void read(uint64_t out[PERF_COUNTERS]) const;
+
+private:
+    int _fds[PERF_COUNTERS];
+    size_t _n_open;
+    int _error; // errno of the first counter that didn't open
+} Perf;
+
+#ifdef PERF_EVENTS
+
+static uint64_t perf_cache_config(const uint64_t cache, const uint64_t result) {
+    return cache | ((uint64_t) PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+// false if none of them could be opened
+bool Perf::init() {
+    const uint32_t types[PERF_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_SOFTWARE,
+    };
+    const uint64_t configs[PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        perf_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        perf_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS),
+        PERF_COUNT_SW_PAGE_FAULTS,
+    };
+
+    _n_open = 0;
+    _error = 0;
+    for (size_t i = 0; i < PERF_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        _fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (_fds[i] == -1) {
+            if (_error == 0) _error = errno;
+            continue;
+        }
+        ++_n_open;
+    }
+    return _n_open > 0;
+}
+
+// 0 for counters that aren't open
+void Perf::read(uint64_t out[PERF_COUNTERS]) const {
+    for (size_t i = 0; i < PERF_COUNTERS; ++i) {
+        out[i] = 0;
+        if (_fds[i] == -1) continue;
+
+        uint64_t values[3]; // value, time enabled, time running
+        if (::read(_fds[i], values, sizeof(values)) != sizeof(values)) continue;
+        if (values[2] == 0) continue;
+        out[i] = (values[2] < values[1])? (uint64_t) ((double) values[0] * values[1] / values[2]) : values[0];
+    }
+}
+
+void Perf::destroy() {
+    for (size_t i = 0; i < PERF_COUNTERS; ++i) {
+        if (_fds[i] != -1) close(_fds[i]);
+    }
+}
+
+#else
+
+// TODO, other platforms have their own counter APIs
+bool Perf::init() {
+    for (size_t i = 0; i < PERF_COUNTERS; ++i) _fds[i] = -1;
+    _n_open = 0;
+    _error = ENOSYS;
+    return false;
+}
+
+void Perf::read(uint64_t out[PERF_COUNTERS]) const {
+    memset(out, 0, PERF_COUNTERS * sizeof(uint64_t));
+}
+
+void Perf::destroy() {
+}
+
+#endif // PERF_EVENTS
+
+#endif // PERF_H
@@ -0,0 +1,90 @@
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "stack.h"
+
+// Monotone bucket queue (Dial's), for small integer priorities that
+// never go below the last one popped, like path costs when each step
+// costs at most max_step: everything pushed is then within max_step of
+// the lowest priority left. A ring of max_step + 1 buckets (rounded up
+// to a power of two) covers that range, one bucket per priority, so
+// push and pop are O(1) amortized and nothing is ever compared.
+// Keys with the same priority come out last in, first out.
+
+template <class K>
+struct PriorityQueue
+{
+    bool init(const uint32_t max_step, const size_t size_hint = 64);
+    void destroy();
+    bool push(const K& key, const uint32_t priority);
+    bool pop(K& key);
+    bool pop(K& key, uint32_t& priority);
+    inline size_t size() const { return _count; }
+    inline bool empty() const { return _count == 0; }
+private:
+    Stack<K>* _buckets;
+    uint32_t _mask;
+    uint32_t _current; // lowest priority that can still be in the queue
+    size_t _count;
+};
+
+// size_hint is the expected size of one bucket
+template <class K>
+bool PriorityQueue<K>::init(const uint32_t max_step, const size_t size_hint) {
+    uint32_t n_buckets = 1;
+    while (n_buckets <= max_step) n_buckets <<= 1;
+    _mask = n_buckets - 1;
+    _current = 0;
+    _count = 0;
+
+    _buckets = (Stack<K>*) malloc(sizeof(Stack<K>) * n_buckets);
+    if (_buckets == NULL) return false;
+    for (uint32_t i = 0; i < n_buckets; ++i) {
+        if (!_buckets[i].init(size_hint)) {
+            for (uint32_t j = 0; j < i; ++j) _buckets[j].destroy();
+            free(_buckets);
+            _buckets = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class K>
+void PriorityQueue<K>::destroy() {
+    if (_buckets == NULL) return;
+    for (uint32_t i = 0; i <= _mask; ++i) _buckets[i].destroy();
+    free(_buckets);
+}
+
+// priority must be within [lowest left, lowest left + max_step]
+template <class K>
+bool PriorityQueue<K>::push(const K& key, const uint32_t priority) {
+    if (_count == 0) _current = priority;
+    if (priority < _current || priority - _current > _mask) return false;
+    if (!_buckets[priority & _mask].push(key)) return false;
+    ++_count;
+    return true;
+}
+
+template <class K>
+bool PriorityQueue<K>::pop(K& key, uint32_t& priority) {
+    if (_count == 0) return false;
+    // all buckets can't be empty, so this stops within one turn
+    while (!_buckets[_current & _mask].pop(key)) ++_current;
+    --_count;
+    priority = _current;
+    return true;
+}
+
+template <class K>
+bool PriorityQueue<K>::pop(K& key) {
+    uint32_t priority;
+    return pop(key, priority);
+}
+
+#endif // PRIORITY_QUEUE_H
@@ -0,0 +1,276 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "perf.h"
+#include "timer.h"
+#include "track_alloc.h"
+
+// Named phases of a run, like "read", "parse", "part1", timed with both
+// the TSC and CLOCK_MONOTONIC_RAW. Phases nest, a phase is identified by
+// its name and the phase it runs in, and calling one again adds to it.
+// Cycles are converted to ns with the TSC rate measured over the run.
+// Set AOC_PROFILE=1 for profile_report to print the table.
+// AOC_PERF=1 also counts cache misses and such per phase with perf.h,
+// printed in a second table, or only timing if counters aren't allowed.
+// Built with -DTRACK_ALLOC, the table also has allocations, bytes
+// allocated and peak live bytes of each phase, and the peak RSS of the
+// process when it ended.
+// Only for the main thread.
+//
+//   profile_begin("parse");
+//   ...
+//   profile_end();
+//
+// or PROFILE("sort"); for the rest of a scope.
+
+static const size_t PROFILE_MAX_PHASES = 32;
+static const size_t PROFILE_MAX_DEPTH = 8;
+static const size_t PROFILE_NONE = (size_t) -1;
+
+typedef struct Phase {
+    const char* name;
+    size_t parent;
+    uint32_t depth;
+    uint32_t calls;
+    uint64_t cycles;
+    uint64_t ns;
+    uint64_t counters[PERF_COUNTERS];
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t peak_live;
+    uint64_t max_rss; // KB
+    // of the running call
+    uint64_t cycle_begin;
+    uint64_t counters_begin[PERF_COUNTERS];
+    uint64_t allocs_begin;
+    uint64_t alloc_bytes_begin;
+    uint64_t outer_peak;
+    struct timespec clock_begin;
+} Phase;
+
+typedef struct Profile {
+    Phase phases[PROFILE_MAX_PHASES];
+    size_t n_phases;
+    size_t stack[PROFILE_MAX_DEPTH];
+    size_t depth;
+    size_t lost; // begins we had no room for
+    size_t too_deep; // of those, still running past PROFILE_MAX_DEPTH
+    uint64_t cycle_origin;
+    struct timespec clock_origin;
+} Profile;
+
+static Profile profile;
+
+// counters stay open across profile_reset
+enum PerfState { PERF_UNKNOWN = 0, PERF_ON, PERF_OFF };
+static Perf profile_perf;
+static PerfState profile_perf_state = PERF_UNKNOWN;
+
+static bool profile_env(const char* name) {
+    const char* env = getenv(name);
+    return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+static void profile_perf_init() {
+    profile_perf_state = PERF_OFF;
+    if (!profile_env("AOC_PERF")) return;
+    if (profile_perf.init()) profile_perf_state = PERF_ON;
+}
+
+static inline uint64_t profile_ns(const struct timespec& from, const struct timespec& to) {
+    return (to.tv_sec - from.tv_sec) * 1000000000 + (to.tv_nsec - from.tv_nsec);
+}
+
+static size_t profile_find(const char* name, const size_t parent) {
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        const Phase& phase = profile.phases[i];
+        if (phase.parent == parent && strcmp(phase.name, name) == 0) return i;
+    }
+    if (profile.n_phases == PROFILE_MAX_PHASES) return PROFILE_NONE;
+
+    Phase& phase = profile.phases[profile.n_phases];
+    memset(&phase, 0, sizeof(phase));
+    phase.name = name;
+    phase.parent = parent;
+    phase.depth = profile.depth;
+    return profile.n_phases++;
+}
+
+// name must outlive the report
+void profile_begin(const char* name) {
+    if (profile_perf_state == PERF_UNKNOWN) profile_perf_init();
+    if (profile.n_phases == 0 && profile.depth == 0) {
+        profile.cycle_origin = __rdtsc();
+        clock_gettime(CLOCK_MONOTONIC_RAW, &profile.clock_origin);
+    }
+
+    // too deep, the matching end only has to balance this
+    if (profile.depth == PROFILE_MAX_DEPTH) {
+        profile.lost += 1;
+        profile.too_deep += 1;
+        return;
+    }
+
+    // inside a phase we couldn't record, or no room for a new one
+    const size_t parent = (profile.depth == 0)? PROFILE_NONE : profile.stack[profile.depth - 1];
+    const bool lost_parent = profile.depth > 0 && parent == PROFILE_NONE;
+    const size_t index = lost_parent? PROFILE_NONE : profile_find(name, parent);
+    if (index == PROFILE_NONE) {
+        profile.lost += 1;
+        profile.stack[profile.depth++] = PROFILE_NONE;
+        return;
+    }
+
+    profile.stack[profile.depth++] = index;
+    Phase& phase = profile.phases[index];
+    if (profile_perf_state == PERF_ON) profile_perf.read(phase.counters_begin);
+#ifdef TRACK_ALLOC
+    phase.allocs_begin = __atomic_load_n(&alloc_stats.count, __ATOMIC_RELAXED);
+    phase.alloc_bytes_begin = __atomic_load_n(&alloc_stats.bytes, __ATOMIC_RELAXED);
+    phase.outer_peak = alloc_peak_reset();
+#endif
+    clock_gettime(CLOCK_MONOTONIC_RAW, &phase.clock_begin);
+    phase.cycle_begin = __rdtsc();
+}
+
+void profile_end() {
+    const uint64_t cycles = __rdtsc();
+    struct timespec clock;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &clock);
+    if (profile.too_deep > 0) {
+        profile.too_deep -= 1;
+        return;
+    }
+    if (profile.depth == 0) return;
+
+    const size_t index = profile.stack[--profile.depth];
+    if (index == PROFILE_NONE) return;
+    Phase& phase = profile.phases[index];
+    phase.calls += 1;
+    phase.cycles += cycles - phase.cycle_begin;
+    phase.ns += profile_ns(phase.clock_begin, clock);
+
+#ifdef TRACK_ALLOC
+    phase.allocs += __atomic_load_n(&alloc_stats.count, __ATOMIC_RELAXED) - phase.allocs_begin;
+    phase.alloc_bytes += __atomic_load_n(&alloc_stats.bytes, __ATOMIC_RELAXED) - phase.alloc_bytes_begin;
+    const uint64_t peak = __atomic_load_n(&alloc_stats.peak, __ATOMIC_RELAXED);
+    if (peak > phase.peak_live) phase.peak_live = peak;
+    alloc_peak_restore(phase.outer_peak);
+    phase.max_rss = alloc_max_rss();
+#endif
+
+    if (profile_perf_state != PERF_ON) return;
+    uint64_t counters[PERF_COUNTERS];
+    profile_perf.read(counters);
+    for (size_t i = 0; i < PERF_COUNTERS; ++i) phase.counters[i] += counters[i] - phase.counters_begin[i];
+}
+
+typedef struct ProfileScope {
+    ProfileScope(const char* name) { profile_begin(name); }
+    ~ProfileScope() { profile_end(); }
+} ProfileScope;
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+// forget everything recorded, between benchmark runs
+void profile_reset() {
+    memset(&profile, 0, sizeof(profile));
+}
+
+bool profile_enabled() {
+    return profile_env("AOC_PROFILE") || profile_env("AOC_PERF");
+}
+
+// TSC rate over everything since the first phase began
+double profile_ns_per_cycle() {
+    const uint64_t cycles = __rdtsc() - profile.cycle_origin;
+    struct timespec clock;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &clock);
+    const uint64_t ns = profile_ns(profile.clock_origin, clock);
+    return (cycles == 0)? 0.0 : (double) ns / cycles;
+}
+
+static void profile_print(const size_t parent, const double ns_per_cycle, const uint64_t total_ns) {
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        const Phase& phase = profile.phases[i];
+        if (phase.parent != parent) continue;
+        printf("%*s%-*s %8" PRIu32 " %12.1f %14" PRIu64 " %12.1f %6.1f%%",
+               (int) phase.depth * 2, "", 20 - (int) phase.depth * 2, phase.name, phase.calls,
+               phase.ns / 1000.0, phase.cycles, phase.cycles * ns_per_cycle / 1000.0,
+               (total_ns == 0)? 0.0 : 100.0 * phase.ns / total_ns);
+#ifdef TRACK_ALLOC
+        printf(" %10" PRIu64 " %12.1f %12.1f %12" PRIu64, phase.allocs, phase.alloc_bytes / 1024.0,
+               phase.peak_live / 1024.0, phase.max_rss);
+#endif
+        printf("\n");
+        profile_print(i, ns_per_cycle, total_ns);
+    }
+}
+
+// counters in the same order as the timing table, IPC when we have both
+static void profile_print_counters(const size_t parent) {
+    const bool ipc = profile_perf.available(PERF_CYCLES) && profile_perf.available(PERF_INSTRUCTIONS);
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        const Phase& phase = profile.phases[i];
+        if (phase.parent != parent) continue;
+        printf("%*s%-*s", (int) phase.depth * 2, "", 20 - (int) phase.depth * 2, phase.name);
+        for (size_t c = 0; c < PERF_COUNTERS; ++c) {
+            if (profile_perf.available((PerfCounter) c)) printf(" %14" PRIu64, phase.counters[c]);
+        }
+        if (ipc) {
+            const uint64_t cycles = phase.counters[PERF_CYCLES];
+            printf(" %6.2f", (cycles == 0)? 0.0 : (double) phase.counters[PERF_INSTRUCTIONS] / cycles);
+        }
+        printf("\n");
+        profile_print_counters(i);
+    }
+}
+
+// The per phase table, % is of the time in top level phases.
+// Nothing unless AOC_PROFILE or AOC_PERF is set.
+void profile_report() {
+    if (!profile_enabled() || profile.n_phases == 0) return;
+
+    uint64_t total_ns = 0;
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        if (profile.phases[i].parent == PROFILE_NONE) total_ns += profile.phases[i].ns;
+    }
+
+    const double ns_per_cycle = profile_ns_per_cycle();
+    printf("Kernels for %s\n", cpu_level());
+    printf("%-20s %8s %12s %14s %12s %7s", "Phase", "calls", "clock µs", "cycles", "tsc µs", "");
+#ifdef TRACK_ALLOC
+    printf(" %10s %12s %12s %12s", "allocs", "KB", "peak KB", "max RSS KB");
+#endif
+    printf("\n");
+    profile_print(PROFILE_NONE, ns_per_cycle, total_ns);
+    if (profile.lost > 0) printf("%zu phases not recorded, too many or too deep\n", profile.lost);
+
+    if (!profile_env("AOC_PERF")) return;
+    if (profile_perf_state != PERF_ON) {
+        printf("No perf counters (%s), timing only\n", strerror(profile_perf.error()));
+        return;
+    }
+    if (profile_perf.count() < PERF_COUNTERS) {
+        printf("Some perf counters aren't available (%s)\n", strerror(profile_perf.error()));
+    }
+    printf("%-20s", "Phase");
+    for (size_t c = 0; c < PERF_COUNTERS; ++c) {
+        if (profile_perf.available((PerfCounter) c)) printf(" %14s", PERF_NAMES[c]);
+    }
+    if (profile_perf.available(PERF_CYCLES) && profile_perf.available(PERF_INSTRUCTIONS)) printf(" %6s", "IPC");
+    printf("\n");
+    profile_print_counters(PROFILE_NONE);
+}
+
+#endif // PROFILE_H
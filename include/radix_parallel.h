@@ -0,0 +1,208 @@
+#ifndef RADIX_PARALLEL_H
+#define RADIX_PARALLEL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "radix_sort.h"
+
+// Radix sort on several threads for arrays in the millions.
+// One MSD pass on the highest byte that differs splits the keys in up to
+// 256 buckets: every thread counts its share of the array, the counts
+// give each thread where to write, and the threads scatter their share
+// in parallel. Buckets are then small enough to stay in cache and are
+// LSD sorted on the remaining bytes, each by whichever thread is free.
+
+// below this many keys, the serial sort is faster
+static const size_t RADIX_PARALLEL_MIN = 1 << 20;
+static const size_t RADIX_MAX_THREADS = 64;
+
+template <typename T>
+struct RadixJob;
+
+template <typename T>
+struct RadixWorker {
+    RadixJob<T>* job;
+    size_t id;
+    size_t begin;
+    size_t end;
+    size_t freqs[RADIX_SIZE];
+    typename RadixKey<T>::type min;
+    typename RadixKey<T>::type max;
+};
+
+template <typename T>
+struct RadixJob {
+    T* a;
+    T* scratch;
+    size_t n_threads;
+    pthread_barrier_t barrier;
+    // nobody starts before all threads are there
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool start;
+    bool cancel;
+    RadixWorker<T> workers[RADIX_MAX_THREADS];
+    size_t buckets[RADIX_SIZE + 1]; // bucket starts, in scratch
+    size_t next_bucket;
+};
+
+// highest byte where keys differ
+template <typename T>
+static size_t radix_msd(const typename RadixKey<T>::type min, const typename RadixKey<T>::type max) {
+    const uint64_t diff = (uint64_t) (min ^ max);
+    return (63 - __builtin_clzll(diff)) / RADIX_BITS;
+}
+
+template <typename T>
+static void* radix_worker(void* arg) {
+    RadixWorker<T>& worker = *(RadixWorker<T>*) arg;
+    RadixJob<T>& job = *worker.job;
+    typedef typename RadixKey<T>::type Key;
+
+    pthread_mutex_lock(&job.lock);
+    while (!job.start && !job.cancel) pthread_cond_wait(&job.cond, &job.lock);
+    const bool cancel = job.cancel;
+    pthread_mutex_unlock(&job.lock);
+    if (cancel) return NULL;
+
+    // count our share on every byte we might split on, plus min and max
+    size_t freqs[sizeof(T)][RADIX_SIZE];
+    radix_histogram(job.a + worker.begin, worker.end - worker.begin, freqs);
+    Key min = (Key) ~(Key) 0;
+    Key max = 0;
+    for (size_t i = worker.begin; i < worker.end; ++i) {
+        const Key key = RadixKey<T>::key(job.a[i]);
+        if (key < min) min = key;
+        if (key > max) max = key;
+    }
+    worker.min = min;
+    worker.max = max;
+    pthread_barrier_wait(&job.barrier);
+
+    // every thread works out the same split from what all counted
+    for (size_t t = 0; t < job.n_threads; ++t) {
+        if (job.workers[t].begin == job.workers[t].end) continue;
+        if (job.workers[t].min < min) min = job.workers[t].min;
+        if (job.workers[t].max > max) max = job.workers[t].max;
+    }
+    // all the same, nothing to sort
+    if (min == max) return NULL;
+    const size_t msd = radix_msd<T>(min, max);
+    memcpy(worker.freqs, freqs[msd], sizeof(worker.freqs));
+    pthread_barrier_wait(&job.barrier);
+
+    // we write bucket d after all earlier buckets, and after what the
+    // threads before us have in bucket d, so the scatter is stable
+    T* queue_ptrs[RADIX_SIZE];
+    size_t offset = 0;
+    for (size_t d = 0; d < RADIX_SIZE; ++d) {
+        if (worker.id == 0) job.buckets[d] = offset;
+        for (size_t t = 0; t < job.n_threads; ++t) {
+            if (t == worker.id) queue_ptrs[d] = job.scratch + offset;
+            offset += job.workers[t].freqs[d];
+        }
+    }
+    if (worker.id == 0) job.buckets[RADIX_SIZE] = offset;
+
+    for (size_t i = worker.begin; i < worker.end; ++i) {
+        const size_t index = radix_digit(job.a[i], msd);
+        *queue_ptrs[index]++ = job.a[i];
+    }
+    pthread_barrier_wait(&job.barrier);
+
+    // buckets are all sorted on the bytes above too, only lower ones left
+    // BETTER, hand out the largest buckets first
+    while (true) {
+        const size_t d = __atomic_fetch_add(&job.next_bucket, 1, __ATOMIC_RELAXED);
+        if (d >= RADIX_SIZE) break;
+        const size_t begin = job.buckets[d];
+        const size_t n = job.buckets[d + 1] - begin;
+        if (n == 0) continue;
+
+        T* bucket = job.scratch + begin;
+        T* target = job.a + begin;
+        if (n <= RADIX_SMALL) {
+            insertion_sort(bucket, n);
+            memcpy(target, bucket, n * sizeof(T));
+            continue;
+        }
+        const T* sorted = radix_sort_low(bucket, n, target, msd);
+        if (sorted != target) memcpy(target, sorted, n * sizeof(T));
+    }
+    return NULL;
+}
+
+// Same as radix_sort, n_threads at 0 uses all online cores.
+// Fewer than threshold keys go to the serial sort.
+template <typename T>
+bool radix_sort_parallel(T* a, const size_t count, T* scratch = NULL, size_t n_threads = 0,
+                         const size_t threshold = RADIX_PARALLEL_MIN) {
+    if (n_threads == 0) {
+        const long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n_cpu > 0)? n_cpu : 1;
+    }
+    if (n_threads > RADIX_MAX_THREADS) n_threads = RADIX_MAX_THREADS;
+    if (count < threshold || count < n_threads * RADIX_SIZE) return radix_sort(a, count, scratch);
+
+    RadixJob<T>* job = (RadixJob<T>*) malloc(sizeof(RadixJob<T>));
+    if (job == NULL) return false;
+
+    T* allocated = NULL;
+    if (scratch == NULL) {
+        allocated = (T*) malloc(count * sizeof(T));
+        if (allocated == NULL) {
+            free(job);
+            return false;
+        }
+        scratch = allocated;
+    }
+
+    job->a = a;
+    job->scratch = scratch;
+    job->n_threads = n_threads;
+    job->next_bucket = 0;
+    job->start = false;
+    job->cancel = false;
+    pthread_barrier_init(&job->barrier, NULL, n_threads);
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    for (size_t t = 0; t < n_threads; ++t) {
+        RadixWorker<T>& worker = job->workers[t];
+        worker.job = job;
+        worker.id = t;
+        worker.begin = count / n_threads * t;
+        worker.end = (t + 1 == n_threads)? count : count / n_threads * (t + 1);
+    }
+
+    // the barrier needs all of them, call it off if one can't start
+    pthread_t threads[RADIX_MAX_THREADS];
+    size_t n_started = 1;
+    while (n_started < n_threads) {
+        if (pthread_create(&threads[n_started], NULL, radix_worker<T>, &job->workers[n_started]) != 0) break;
+        ++n_started;
+    }
+    bool ok = (n_started == n_threads);
+
+    pthread_mutex_lock(&job->lock);
+    if (ok) job->start = true;
+    else job->cancel = true;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+
+    if (ok) radix_worker<T>(&job->workers[0]);
+    for (size_t t = 1; t < n_started; ++t) pthread_join(threads[t], NULL);
+
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    pthread_barrier_destroy(&job->barrier);
+    free(job);
+
+    if (!ok) ok = radix_sort(a, count, scratch);
+    free(allocated);
+    return ok;
+}
+
+#endif // RADIX_PARALLEL_H
@@ -0,0 +1,345 @@
+/*
+MIT License
+
+Copyright (c) 2019 Travis Downs
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+// LSD radix sort for any integer type, one byte per pass,
+// so sizeof(T) passes at most. Passes where every key has the same
+// byte are skipped. Signed keys get their sign bit flipped on the way,
+// so negatives come first.
+
+static const size_t RADIX_BITS = 8;
+static const size_t RADIX_SIZE = (size_t) 1 << RADIX_BITS;
+static const size_t RADIX_MASK = RADIX_SIZE - 1;
+
+// below this, histograms cost more than they save
+static const size_t RADIX_SMALL = 64;
+
+// unsigned key of T, in the same order as T
+template <typename T> struct RadixKey;
+
+#define RADIX_KEY(T, U, FLIP) \
+template <> struct RadixKey<T> { \
+    typedef U type; \
+    static inline U key(const T value) { return (U) value ^ (FLIP); } \
+};
+
+RADIX_KEY(uint8_t, uint8_t, 0)
+RADIX_KEY(uint16_t, uint16_t, 0)
+RADIX_KEY(uint32_t, uint32_t, 0)
+RADIX_KEY(uint64_t, uint64_t, 0)
+RADIX_KEY(int8_t, uint8_t, (uint8_t) 0x80)
+RADIX_KEY(int16_t, uint16_t, (uint16_t) 0x8000)
+RADIX_KEY(int32_t, uint32_t, (uint32_t) 0x80000000)
+RADIX_KEY(int64_t, uint64_t, (uint64_t) 0x8000000000000000)
+
+#undef RADIX_KEY
+
+template <typename T>
+static inline size_t radix_digit(const T value, const size_t pass) {
+    return (RadixKey<T>::key(value) >> (pass * RADIX_BITS)) & RADIX_MASK;
+}
+
+// one histogram per byte for the low n_passes bytes,
+// all from a single read of the keys, built for each CPU level
+template <typename T>
+CPU_CLONES static void radix_histogram(const T* a, const size_t count, size_t freqs[][RADIX_SIZE],
+                            const size_t n_passes = sizeof(T)) {
+    memset(freqs, 0, n_passes * RADIX_SIZE * sizeof(size_t));
+    for (size_t i = 0; i < count; ++i) {
+        typename RadixKey<T>::type key = RadixKey<T>::key(a[i]);
+        for (size_t pass = 0; pass < n_passes; ++pass) {
+            freqs[pass][key & RADIX_MASK]++;
+            key >>= RADIX_BITS;
+        }
+    }
+}
+
+/**
+ * Determine if the frequencies for a given level are "trivial".
+ *
+ * Frequencies are trivial if only a single frequency has non-zero
+ * occurrences. In that case, the radix step just acts as a copy so we can
+ * skip it.
+ */
+static bool is_trivial(const size_t freqs[RADIX_SIZE], const size_t count) {
+    for (size_t i = 0; i < RADIX_SIZE; ++i) {
+        if (freqs[i] != 0) return freqs[i] == count;
+    }
+    return true; // count is zero
+}
+
+template <typename T>
+static void insertion_sort(T* a, const size_t count) {
+    for (size_t i = 1; i < count; ++i) {
+        const T value = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > value) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = value;
+    }
+}
+
+// stable, on keys only
+template <typename K, typename V>
+static void insertion_sort_pairs(K* keys, V* values, const size_t count) {
+    for (size_t i = 1; i < count; ++i) {
+        const K key = keys[i];
+        const V value = values[i];
+        size_t j = i;
+        while (j > 0 && keys[j - 1] > key) {
+            keys[j] = keys[j - 1];
+            values[j] = values[j - 1];
+            --j;
+        }
+        keys[j] = key;
+        values[j] = value;
+    }
+}
+
+// where each queue starts, packed from their known sizes
+template <typename T>
+static inline void radix_queues(const size_t freqs[RADIX_SIZE], T* base, T* queue_ptrs[RADIX_SIZE]) {
+    for (size_t i = 0; i < RADIX_SIZE; ++i) {
+        queue_ptrs[i] = base;
+        base += freqs[i];
+    }
+}
+
+// Sort on the low n_passes bytes only, the others must be the same
+// for all keys. Return where the result ended up, a or scratch.
+template <typename T>
+static T* radix_sort_low(T* a, const size_t count, T* scratch, const size_t n_passes) {
+    size_t freqs[sizeof(T)][RADIX_SIZE];
+    radix_histogram(a, count, freqs, n_passes);
+
+    T* from = a;
+    T* to = scratch;
+    for (size_t pass = 0; pass < n_passes; ++pass) {
+        // this pass would do nothing, just skip it
+        if (is_trivial(freqs[pass], count)) continue;
+
+        T* queue_ptrs[RADIX_SIZE];
+        radix_queues(freqs[pass], to, queue_ptrs);
+
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = radix_digit(from[i], pass);
+            *queue_ptrs[index]++ = from[i];
+            __builtin_prefetch(queue_ptrs[index]);
+        }
+
+        T* swap = from;
+        from = to;
+        to = swap;
+    }
+    return from;
+}
+
+// scratch needs room for count elements, it's reused between passes.
+// Pass NULL to have one allocated for this call only.
+// Return false if that allocation failed.
+template <typename T>
+bool radix_sort(T* a, const size_t count, T* scratch = NULL) {
+    if (count <= RADIX_SMALL) {
+        insertion_sort(a, count);
+        return true;
+    }
+
+    T* allocated = NULL;
+    if (scratch == NULL) {
+        allocated = (T*) malloc(count * sizeof(T));
+        if (allocated == NULL) return false;
+        scratch = allocated;
+    }
+
+    // after an odd number of passes the result is in scratch
+    const T* sorted = radix_sort_low(a, count, scratch, sizeof(T));
+    if (sorted != a) memcpy(a, sorted, count * sizeof(T));
+
+    free(allocated);
+    return true;
+}
+
+// Sort keys and move values along with them, equal keys keep their order.
+// Scratch buffers are the same as for radix_sort, one per array.
+template <typename K, typename V>
+bool radix_sort_pairs(K* keys, V* values, const size_t count,
+                      K* key_scratch = NULL, V* value_scratch = NULL) {
+    if (count <= RADIX_SMALL) {
+        insertion_sort_pairs(keys, values, count);
+        return true;
+    }
+
+    K* allocated_keys = NULL;
+    V* allocated_values = NULL;
+    if (key_scratch == NULL) key_scratch = allocated_keys = (K*) malloc(count * sizeof(K));
+    if (value_scratch == NULL) value_scratch = allocated_values = (V*) malloc(count * sizeof(V));
+    if (key_scratch == NULL || value_scratch == NULL) {
+        free(allocated_keys);
+        free(allocated_values);
+        return false;
+    }
+
+    size_t freqs[sizeof(K)][RADIX_SIZE];
+    radix_histogram(keys, count, freqs);
+
+    K* from = keys;
+    K* to = key_scratch;
+    V* from_values = values;
+    V* to_values = value_scratch;
+    for (size_t pass = 0; pass < sizeof(K); ++pass) {
+        if (is_trivial(freqs[pass], count)) continue;
+
+        K* queue_ptrs[RADIX_SIZE];
+        V* value_ptrs[RADIX_SIZE];
+        radix_queues(freqs[pass], to, queue_ptrs);
+        radix_queues(freqs[pass], to_values, value_ptrs);
+
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = radix_digit(from[i], pass);
+            *queue_ptrs[index]++ = from[i];
+            *value_ptrs[index]++ = from_values[i];
+        }
+
+        K* swap = from;
+        from = to;
+        to = swap;
+        V* swap_values = from_values;
+        from_values = to_values;
+        to_values = swap_values;
+    }
+
+    if (from != keys) {
+        memcpy(keys, from, count * sizeof(K));
+        memcpy(values, from_values, count * sizeof(V));
+    }
+
+    free(allocated_keys);
+    free(allocated_values);
+    return true;
+}
+
+// Write in order the indices of keys in sorted order, keys are left as is.
+// Equal keys keep their order. I must be able to hold count - 1.
+// scratch needs room for count indices, NULL to allocate one.
+// BETTER, each pass reads keys through the indices, sorting a copy of
+// the keys along with the indices might be faster for large arrays
+template <typename K, typename I>
+bool radix_argsort(const K* keys, const size_t count, I* order, I* scratch = NULL) {
+    for (size_t i = 0; i < count; ++i) order[i] = i;
+
+    if (count <= RADIX_SMALL) {
+        for (size_t i = 1; i < count; ++i) {
+            const I index = order[i];
+            size_t j = i;
+            while (j > 0 && keys[order[j - 1]] > keys[index]) {
+                order[j] = order[j - 1];
+                --j;
+            }
+            order[j] = index;
+        }
+        return true;
+    }
+
+    I* allocated = NULL;
+    if (scratch == NULL) {
+        allocated = (I*) malloc(count * sizeof(I));
+        if (allocated == NULL) return false;
+        scratch = allocated;
+    }
+
+    size_t freqs[sizeof(K)][RADIX_SIZE];
+    radix_histogram(keys, count, freqs);
+
+    I* from = order;
+    I* to = scratch;
+    for (size_t pass = 0; pass < sizeof(K); ++pass) {
+        if (is_trivial(freqs[pass], count)) continue;
+
+        I* queue_ptrs[RADIX_SIZE];
+        radix_queues(freqs[pass], to, queue_ptrs);
+
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = radix_digit(keys[from[i]], pass);
+            *queue_ptrs[index]++ = from[i];
+        }
+
+        I* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != order) memcpy(order, from, count * sizeof(I));
+
+    free(allocated);
+    return true;
+}
+
+// k-th smallest of a (0 based), without sorting it.
+// From the highest byte where keys differ down, only the keys in the
+// bucket holding the k-th one are kept, moved to the front of a.
+// The first histogram covers every byte in one read, later ones only the
+// keys left. a keeps the same keys in another order.
+template <typename T>
+T radix_select(T* a, const size_t count, size_t k) {
+    size_t freqs[sizeof(T)][RADIX_SIZE];
+    radix_histogram(a, count, freqs);
+
+    size_t n = count;
+    bool first = true;
+    for (size_t pass = sizeof(T); pass-- > 0 && n > 1;) {
+        if (!first) {
+            memset(freqs[pass], 0, sizeof(freqs[pass]));
+            for (size_t i = 0; i < n; ++i) freqs[pass][radix_digit(a[i], pass)]++;
+        }
+        // the keys left all share this byte
+        if (is_trivial(freqs[pass], n)) continue;
+        first = false;
+
+        size_t bucket = 0;
+        while (k >= freqs[pass][bucket]) k -= freqs[pass][bucket++];
+
+        size_t kept = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (radix_digit(a[i], pass) != bucket) continue;
+            const T swap = a[kept];
+            a[kept++] = a[i];
+            a[i] = swap;
+        }
+        n = kept;
+    }
+    // what's left is all the same key
+    return a[k];
+}
+
+#endif // RADIX_SORT_H
@@ -0,0 +1,103 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "file.h"
+#include "strtoint.h"
+
+// Scanner for fixed layout records like "x=20..30, y=-10..-5".
+// The format is compiled once: literal text with a %d slot for each
+// signed 32 bits integer, e.g. "x=%d..%d, y=%d..%d".
+// A scan checks a whole line in one pass: literals are compared a word
+// at a time when they fit, numbers go through parse_int32, and every
+// step knows how many bytes the rest needs at least, so nothing is read
+// past the line.
+
+static const uint8_t RECORD_MAX_SLOTS = 16;
+
+typedef struct Literal {
+    const char* str;
+    uint64_t word; // the literal in the low bytes when it fits in 8
+    uint64_t mask;
+    uint16_t size;
+    uint16_t rest; // minimum size of what follows, literal included
+} Literal;
+
+typedef struct Record {
+    bool compile(const char* format);
+    bool scan(const LineView& line, int32_t* out) const;
+    uint8_t slots() const { return _n_slots; }
+
+private:
+    Literal _literals[RECORD_MAX_SLOTS + 1]; // before each slot, then the trailing one
+    uint8_t _n_slots;
+} Record;
+
+// the format must outlive the record
+bool Record::compile(const char* format) {
+    _n_slots = 0;
+    const char* literal = format;
+    const char* it = format;
+    while (true) {
+        const bool slot = (it[0] == '%' && it[1] == 'd');
+        if (!slot && *it != '\0') {
+            ++it;
+            continue;
+        }
+
+        // two slots in a row can't be told apart
+        if (slot && _n_slots > 0 && it == literal) return false;
+        if (slot && _n_slots == RECORD_MAX_SLOTS) return false;
+
+        Literal& l = _literals[_n_slots];
+        l.str = literal;
+        l.size = it - literal;
+        l.word = 0;
+        l.mask = 0;
+        if (l.size <= 8) {
+            memcpy(&l.word, literal, l.size);
+            l.mask = (l.size == 8)? ~(uint64_t) 0 : (((uint64_t) 1 << (l.size * 8)) - 1);
+        }
+
+        if (!slot) break;
+        ++_n_slots;
+        it += 2;
+        literal = it;
+    }
+
+    // at least one digit per slot
+    uint16_t rest = 0;
+    for (int i = _n_slots; i >= 0; --i) {
+        rest += _literals[i].size + ((i < _n_slots)? 1 : 0);
+        _literals[i].rest = rest;
+    }
+    return true;
+}
+
+// fill out with one value per slot, the line must match all the way
+bool Record::scan(const LineView& line, int32_t* out) const {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    for (uint8_t i = 0; i <= _n_slots; ++i) {
+        const Literal& l = _literals[i];
+        if ((size_t)(end - it) < l.rest) return false;
+
+        if (l.mask != 0 && end - it >= 8) {
+            uint64_t word;
+            memcpy(&word, it, sizeof(word));
+            if (((word ^ l.word) & l.mask) != 0) return false;
+        } else if (memcmp(it, l.str, l.size) != 0) {
+            return false;
+        }
+        it += l.size;
+
+        if (i == _n_slots) break;
+        if (parse_int32(it, end, out[i]) != INT_OK) return false;
+    }
+    return it == end;
+}
+
+#endif // RECORD_H
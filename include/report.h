@@ -0,0 +1,235 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "file.h"
+#include "profile.h"
+
+// One machine readable record per run of a day, set AOC_REPORT=json or
+// AOC_REPORT=csv. It's printed after the day's own output, or appended
+// to AOC_REPORT_FILE if set, so ./run.sh can collect all days in one file.
+// The record has the day, a hash of the input, the answers, the timing
+// of the run (the spread with AOC_BENCH) and every profiled phase with
+// its counters and allocations when those are on.
+// JSON is one object per line. CSV is one row per phase plus a "total"
+// row, with the same columns whatever was measured, which is what
+// out/report_compare reads to check a run against a baseline.
+
+static const size_t REPORT_MAX_ANSWERS = 4;
+static const size_t REPORT_ANSWER_SIZE = 64;
+static const size_t REPORT_NAME_SIZE = 128;
+
+enum ReportFormat { REPORT_NONE = 0, REPORT_JSON, REPORT_CSV };
+
+// timing of all the runs of a day, in ns
+typedef struct BenchStats {
+    uint32_t runs;
+    uint64_t min;
+    uint64_t median;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t max;
+    double mean;
+    double stddev;
+} BenchStats;
+
+typedef struct Answers {
+    char values[REPORT_MAX_ANSWERS][REPORT_ANSWER_SIZE];
+    size_t count;
+} Answers;
+
+static Answers report_answers;
+
+// days call it once per answer, in order
+__attribute__((format(printf, 1, 2)))
+void report_answer(const char* format, ...) {
+    if (report_answers.count == REPORT_MAX_ANSWERS) return;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(report_answers.values[report_answers.count++], REPORT_ANSWER_SIZE, format, args);
+    va_end(args);
+}
+
+void report_reset() {
+    report_answers.count = 0;
+}
+
+ReportFormat report_format() {
+    const char* env = getenv("AOC_REPORT");
+    if (env == NULL) return REPORT_NONE;
+    if (strcmp(env, "json") == 0) return REPORT_JSON;
+    if (strcmp(env, "csv") == 0) return REPORT_CSV;
+    return REPORT_NONE;
+}
+
+// "part1/select" for nested phases
+static void report_phase_name(const size_t index, char* out, const size_t size) {
+    const Phase& phase = profile.phases[index];
+    if (phase.parent == PROFILE_NONE) {
+        snprintf(out, size, "%s", phase.name);
+        return;
+    }
+    report_phase_name(phase.parent, out, size);
+    const size_t length = strlen(out);
+    snprintf(out + length, size - length, "/%s", phase.name);
+}
+
+static void report_json_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const char* it = str; *it != '\0'; ++it) {
+        const unsigned char c = *it;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// CSV fields are quoted, quotes doubled
+static void report_csv_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const char* it = str; *it != '\0'; ++it) {
+        if (*it == '"') fputc('"', out);
+        fputc(*it, out);
+    }
+    fputc('"', out);
+}
+
+static void report_json(FILE* out, const char* day, const char* input, const uint64_t hash,
+                        const BenchStats& stats) {
+    fprintf(out, "{\"day\":");
+    report_json_string(out, day);
+    fprintf(out, ",\"input\":");
+    report_json_string(out, input);
+    fprintf(out, ",\"input_hash\":\"%016" PRIx64 "\",\"answers\":[", hash);
+    for (size_t i = 0; i < report_answers.count; ++i) {
+        if (i > 0) fputc(',', out);
+        report_json_string(out, report_answers.values[i]);
+    }
+    fprintf(out, "],\"runs\":%" PRIu32 ",\"min_ns\":%" PRIu64 ",\"median_ns\":%" PRIu64
+            ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64
+            ",\"mean_ns\":%.0f,\"stddev_ns\":%.0f,\"phases\":[",
+            stats.runs, stats.min, stats.median, stats.p90, stats.p99, stats.max, stats.mean, stats.stddev);
+
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        const Phase& phase = profile.phases[i];
+        char name[REPORT_NAME_SIZE];
+        report_phase_name(i, name, sizeof(name));
+        if (i > 0) fputc(',', out);
+        fprintf(out, "{\"name\":");
+        report_json_string(out, name);
+        fprintf(out, ",\"calls\":%" PRIu32 ",\"ns\":%" PRIu64 ",\"cycles\":%" PRIu64,
+                phase.calls, phase.ns, phase.cycles);
+        if (profile_perf_state == PERF_ON) {
+            fprintf(out, ",\"counters\":{");
+            bool first = true;
+            for (size_t c = 0; c < PERF_COUNTERS; ++c) {
+                if (!profile_perf.available((PerfCounter) c)) continue;
+                fprintf(out, "%s\"%s\":%" PRIu64, first? "" : ",", PERF_NAMES[c], phase.counters[c]);
+                first = false;
+            }
+            fputc('}', out);
+        }
+#ifdef TRACK_ALLOC
+        fprintf(out, ",\"allocs\":%" PRIu64 ",\"alloc_bytes\":%" PRIu64 ",\"peak_live\":%" PRIu64
+                ",\"max_rss_kb\":%" PRIu64, phase.allocs, phase.alloc_bytes, phase.peak_live, phase.max_rss);
+#endif
+        fputc('}', out);
+    }
+    fprintf(out, "]}\n");
+}
+
+static void report_csv_header(FILE* out) {
+    fprintf(out, "day,input_hash,answers,phase,calls,ns_per_call,min_ns,median_ns,p90_ns,p99_ns,max_ns,"
+            "stddev_ns,cycles_per_call");
+    for (size_t c = 0; c < PERF_COUNTERS; ++c) fprintf(out, ",%s", PERF_NAMES[c]);
+    fprintf(out, ",allocs,alloc_bytes,peak_live,max_rss_kb\n");
+}
+
+static void report_csv(FILE* out, const char* day, const uint64_t hash, const BenchStats& stats) {
+    char answers[REPORT_MAX_ANSWERS * REPORT_ANSWER_SIZE] = "";
+    for (size_t i = 0; i < report_answers.count; ++i) {
+        if (i > 0) strcat(answers, ";");
+        strcat(answers, report_answers.values[i]);
+    }
+
+    // the run as a whole, counters are per phase only
+    report_csv_string(out, day);
+    fprintf(out, ",%016" PRIx64 ",", hash);
+    report_csv_string(out, answers);
+    fprintf(out, ",\"total\",%" PRIu32 ",%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.0f,",
+            stats.runs, stats.mean, stats.min, stats.median, stats.p90, stats.p99, stats.max, stats.stddev);
+    for (size_t c = 0; c < PERF_COUNTERS; ++c) fputc(',', out);
+    fprintf(out, ",,,,\n");
+
+    for (size_t i = 0; i < profile.n_phases; ++i) {
+        const Phase& phase = profile.phases[i];
+        const double calls = (phase.calls == 0)? 1.0 : phase.calls;
+        char name[REPORT_NAME_SIZE];
+        report_phase_name(i, name, sizeof(name));
+
+        report_csv_string(out, day);
+        fprintf(out, ",%016" PRIx64 ",", hash);
+        report_csv_string(out, answers);
+        fputc(',', out);
+        report_csv_string(out, name);
+        fprintf(out, ",%" PRIu32 ",%.0f,,,,,,,%.0f", phase.calls, phase.ns / calls, phase.cycles / calls);
+        for (size_t c = 0; c < PERF_COUNTERS; ++c) {
+            if (profile_perf_state == PERF_ON && profile_perf.available((PerfCounter) c)) {
+                fprintf(out, ",%.0f", phase.counters[c] / calls);
+            } else {
+                fputc(',', out);
+            }
+        }
+#ifdef TRACK_ALLOC
+        fprintf(out, ",%.0f,%.0f,%" PRIu64 ",%" PRIu64 "\n", phase.allocs / calls, phase.alloc_bytes / calls,
+                phase.peak_live, phase.max_rss);
+#else
+        fprintf(out, ",,,,\n");
+#endif
+    }
+}
+
+// day is the program name, input the path it read
+bool report_emit(const char* day, const char* input, const BenchStats& stats) {
+    const ReportFormat format = report_format();
+    if (format == REPORT_NONE) return true;
+
+    uint64_t hash = 0;
+    File file;
+    if (file.open(input)) {
+        hash = cache_checksum(file.data(), file.size());
+        file.close();
+    }
+
+    FILE* out = stdout;
+    const char* path = getenv("AOC_REPORT_FILE");
+    if (path != NULL && path[0] != '\0') {
+        out = fopen(path, "a");
+        if (out == NULL) return false;
+    }
+
+    // a new CSV file starts with its header
+    if (format == REPORT_CSV) {
+        struct stat out_stat;
+        if (out == stdout || (fstat(fileno(out), &out_stat) == 0 && out_stat.st_size == 0)) report_csv_header(out);
+        report_csv(out, day, hash, stats);
+    } else {
+        report_json(out, day, input, hash, stats);
+    }
+
+    if (out != stdout) return fclose(out) == 0;
+    fflush(out);
+    return true;
+}
+
+#endif // REPORT_H
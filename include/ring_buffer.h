@@ -2,66 +2,103 @@
 #define RING_BUFFER_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+// Sliding window over the last size samples pushed.
+// Storage is rounded up to a power of two so wrapping is a mask.
+// The sum is kept up to date on push, and with extremes on, min and max
+// too through monotonic queues of sample numbers, so all three are O(1)
+// whatever the window size. Meant for integers, a floating sum would
+// drift as samples come and go.
+
 template <class T>
 struct Ringbuffer
 {
     inline size_t size() const { return _size; }
-    T& operator[](size_t i) const { return _data[i]; }
-    T* data() { return _data; }
-    void init(const size_t);
+    inline size_t count() const { return (_pushed < _size)? _pushed : _size; }
+    // 0 is the oldest sample in the window
+    T& operator[](size_t i) const { return _data[(_pushed - count() + i) & _mask]; }
+    bool init(const size_t size, const bool extremes = false);
     void clear();
     void free();
-    T const sum();
+    T sum() const { return _sum; }
+    T min() const { return _data[_min_queue[_min_head & _mask] & _mask]; }
+    T max() const { return _data[_max_queue[_max_head & _mask] & _mask]; }
     T& last();
     void push(T t);
 private:
     size_t _size;
-    size_t _idx;
+    size_t _mask;
+    uint64_t _pushed; // number of the next sample
     T* _data;
+    T _sum;
+    // sample numbers, values only go up from head to tail for min,
+    // down for max, NULL when extremes are off
+    uint64_t* _min_queue;
+    uint64_t* _max_queue;
+    uint64_t _min_head, _min_tail;
+    uint64_t _max_head, _max_tail;
 };
 
 template <class T>
 T& Ringbuffer<T>::last() {
-    if (_idx == 0) return _data[_size-1];
-    return _data[_idx-1];
+    return _data[(_pushed - 1) & _mask];
 }
 
 // TODO implement move if using not built-in type
 template <class T>
 void Ringbuffer<T>::push(T t) {
-    _data[_idx] = t;
-    if ((++_idx) >= _size) _idx = 0;
+    // the oldest one leaves the window, read it before it's overwritten
+    if (_pushed >= _size) _sum -= _data[(_pushed - _size) & _mask];
+    _data[_pushed & _mask] = t;
+    _sum += t;
+
+    if (_min_queue != NULL) {
+        // a queue never holds more than the window, so it fits in the mask
+        const uint64_t oldest = (_pushed >= _size)? _pushed - _size + 1 : 0;
+        if (_min_head != _min_tail && _min_queue[_min_head & _mask] < oldest) ++_min_head;
+        if (_max_head != _max_tail && _max_queue[_max_head & _mask] < oldest) ++_max_head;
+        while (_min_head != _min_tail && _data[_min_queue[(_min_tail - 1) & _mask] & _mask] >= t) --_min_tail;
+        while (_max_head != _max_tail && _data[_max_queue[(_max_tail - 1) & _mask] & _mask] <= t) --_max_tail;
+        _min_queue[_min_tail++ & _mask] = _pushed;
+        _max_queue[_max_tail++ & _mask] = _pushed;
+    }
+    ++_pushed;
 }
 
 template <class T>
 void Ringbuffer<T>::clear() {
-    for (size_t i = 0; i < _size; ++i) {
-        _data[i] = 0;
-    }
-    _idx = 0;
+    _pushed = 0;
+    _sum = 0;
+    _min_head = _min_tail = 0;
+    _max_head = _max_tail = 0;
 }
 
 template <class T>
-void Ringbuffer<T>::init(const size_t size) {
+bool Ringbuffer<T>::init(const size_t size, const bool extremes) {
     _size = size;
-    _idx = 0;
-    _data = (T*) malloc(sizeof(T) * _size);
-}
+    size_t capacity = 1;
+    while (capacity < size) capacity <<= 1;
+    _mask = capacity - 1;
+    _min_queue = NULL;
+    _max_queue = NULL;
+    clear();
 
-template <class T>
-const T Ringbuffer<T>::sum() {
-    T total = 0;
-    for (size_t i = 0; i < _size; ++i) {
-        total += _data[i];
-    }
-    return total;
+    _data = (T*) malloc(sizeof(T) * capacity);
+    if (_data == NULL) return false;
+    if (!extremes) return true;
+
+    _min_queue = (uint64_t*) malloc(sizeof(uint64_t) * capacity);
+    _max_queue = (uint64_t*) malloc(sizeof(uint64_t) * capacity);
+    return _min_queue != NULL && _max_queue != NULL;
 }
 
 template <class T>
 void Ringbuffer<T>::free() {
     ::free(_data);
+    ::free(_min_queue);
+    ::free(_max_queue);
 }
 
 #endif // RING_BUFFER_H
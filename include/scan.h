@@ -0,0 +1,179 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cpu.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Byte scanning 16 bytes at a time with SSE2, 32 with AVX2 and 64 with
+// AVX-512. scan_byte, count_byte and scan_all pick theirs when the
+// program starts, see cpu.h. scan_block and scan_digits are for loops
+// inlined elsewhere, like csv.h, and use what the build allows.
+// Loads are unaligned, tails are done one byte at a time so we never
+// read past the end of the buffer.
+
+// one bit per byte of the block
+// BETTER, these are only SSE2 in a baseline build, csv.h could take
+// the block as a template like the loops below
+typedef uint32_t scan_mask;
+
+#ifdef __AVX2__
+static const size_t SCAN_WIDTH = 32;
+static const scan_mask SCAN_FULL = 0xFFFFFFFF;
+
+static inline scan_mask scan_block(const char* p, const char c) {
+    const __m256i block = _mm256_loadu_si256((const __m256i*) p);
+    return (scan_mask) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+}
+
+// '0' to '9' are moved to the bottom of the signed range,
+// so one compare leaves everything else out
+static inline scan_mask scan_digits(const char* p) {
+    const __m256i block = _mm256_loadu_si256((const __m256i*) p);
+    const __m256i shifted = _mm256_sub_epi8(block, _mm256_set1_epi8('0' - 128));
+    return (scan_mask) _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 10), shifted));
+}
+#else
+static const size_t SCAN_WIDTH = 16;
+static const scan_mask SCAN_FULL = 0xFFFF;
+
+static inline scan_mask scan_block(const char* p, const char c) {
+    const __m128i block = _mm_loadu_si128((const __m128i*) p);
+    return (scan_mask) _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+}
+
+static inline scan_mask scan_digits(const char* p) {
+    const __m128i block = _mm_loadu_si128((const __m128i*) p);
+    const __m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8('0' - 128));
+    return (scan_mask) _mm_movemask_epi8(_mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 10)));
+}
+#endif
+
+// one block per step of the dispatched loops, find gives a bit per byte
+struct ScanBlock16 {
+    typedef uint32_t mask;
+    static const size_t WIDTH = 16;
+    static inline mask find(const char* p, const char c) {
+        const __m128i block = _mm_loadu_si128((const __m128i*) p);
+        return (mask) _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+    }
+};
+
+#ifdef CPU_DISPATCH
+struct ScanBlock32 {
+    typedef uint32_t mask;
+    static const size_t WIDTH = 32;
+    CPU_TARGET_AVX2 static inline mask find(const char* p, const char c) {
+        const __m256i block = _mm256_loadu_si256((const __m256i*) p);
+        return (mask) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+    }
+};
+
+struct ScanBlock64 {
+    typedef uint64_t mask;
+    static const size_t WIDTH = 64;
+    CPU_TARGET_AVX512 static inline mask find(const char* p, const char c) {
+        const __m512i block = _mm512_loadu_si512((const void*) p);
+        return _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(c));
+    }
+};
+#endif
+
+template <typename Block>
+static inline const char* scan_byte_with(const char* p, const char* end, const char c) {
+    while ((size_t)(end - p) >= Block::WIDTH) {
+        const typename Block::mask mask = Block::find(p, c);
+        if (mask != 0) return p + __builtin_ctzll(mask);
+        p += Block::WIDTH;
+    }
+    while (p < end && *p != c) ++p;
+    return p;
+}
+
+template <typename Block>
+static inline size_t count_byte_with(const char* p, const char* end, const char c) {
+    size_t count = 0;
+    while ((size_t)(end - p) >= Block::WIDTH) {
+        count += __builtin_popcountll(Block::find(p, c));
+        p += Block::WIDTH;
+    }
+    while (p < end) count += (*p++ == c);
+    return count;
+}
+
+template <typename Block>
+static inline size_t scan_all_with(const char* data, const off_t size, const char c, off_t* out, const size_t max) {
+    size_t n = 0;
+    off_t it = 0;
+    while (size - it >= (off_t) Block::WIDTH && n < max) {
+        typename Block::mask mask = Block::find(data + it, c);
+        while (mask != 0) {
+            if (n == max) return n;
+            out[n++] = it + __builtin_ctzll(mask) + 1;
+            mask &= mask - 1;
+        }
+        it += Block::WIDTH;
+    }
+    while (it < size && n < max) {
+        if (data[it] == c) out[n++] = it + 1;
+        ++it;
+    }
+    return n;
+}
+
+// first occurrence of c in [p, end), end if there's none
+CPU_DEFAULT const char* scan_byte(const char* p, const char* end, const char c) {
+    return scan_byte_with<ScanBlock16>(p, end, c);
+}
+
+// number of c in [p, end)
+CPU_DEFAULT size_t count_byte(const char* p, const char* end, const char c) {
+    return count_byte_with<ScanBlock16>(p, end, c);
+}
+
+// write the offset following each c in data into out, up to max of them
+// return how many were written
+CPU_DEFAULT size_t scan_all(const char* data, const off_t size, const char c, off_t* out, const size_t max) {
+    return scan_all_with<ScanBlock16>(data, size, c, out, max);
+}
+
+#ifdef CPU_DISPATCH
+// popcnt instead of a libgcc call
+CPU_V2 size_t count_byte(const char* p, const char* end, const char c) {
+    return count_byte_with<ScanBlock16>(p, end, c);
+}
+
+CPU_V3 const char* scan_byte(const char* p, const char* end, const char c) {
+    return scan_byte_with<ScanBlock32>(p, end, c);
+}
+
+CPU_V3 size_t count_byte(const char* p, const char* end, const char c) {
+    return count_byte_with<ScanBlock32>(p, end, c);
+}
+
+CPU_V3 size_t scan_all(const char* data, const off_t size, const char c, off_t* out, const size_t max) {
+    return scan_all_with<ScanBlock32>(data, size, c, out, max);
+}
+
+CPU_V4 const char* scan_byte(const char* p, const char* end, const char c) {
+    return scan_byte_with<ScanBlock64>(p, end, c);
+}
+
+CPU_V4 size_t count_byte(const char* p, const char* end, const char c) {
+    return count_byte_with<ScanBlock64>(p, end, c);
+}
+
+CPU_V4 size_t scan_all(const char* data, const off_t size, const char c, off_t* out, const size_t max) {
+    return scan_all_with<ScanBlock64>(data, size, c, out, max);
+}
+#endif // CPU_DISPATCH
+
+#endif // SCAN_H
@@ -0,0 +1,142 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lock-free queue between exactly one producer thread and one consumer
+// thread, e.g. one parsing lines while the other solves.
+// Each side only writes its own index and publishes it with a release
+// store, the other side reads it with an acquire load. Each side also
+// keeps its last view of the other index, so the shared cache line is
+// only read when that view says the queue is full or empty.
+// Items are copied with memcpy, T must be trivially copyable.
+
+static const size_t SPSC_CACHE_LINE = 64;
+
+template <typename T>
+struct SpscQueue {
+    bool init(const size_t capacity);
+    void destroy();
+
+    // producer side
+    size_t push(const T* items, const size_t n);
+    void push_all(const T* items, size_t n);
+    void close();
+
+    // consumer side
+    size_t pop(T* items, const size_t max);
+    size_t pop_wait(T* items, const size_t max);
+
+private:
+    void copy_in(const uint64_t at, const T* items, const size_t n);
+    void copy_out(const uint64_t at, T* items, const size_t n);
+
+    alignas(SPSC_CACHE_LINE) uint64_t _head; // written by the consumer
+    uint64_t _tail_seen;
+    alignas(SPSC_CACHE_LINE) uint64_t _tail; // written by the producer
+    uint64_t _head_seen;
+    bool _closed;
+    alignas(SPSC_CACHE_LINE) T* _items;
+    size_t _mask;
+};
+
+// capacity is rounded up to a power of two
+template <typename T>
+bool SpscQueue<T>::init(const size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    _mask = size - 1;
+    _head = _tail_seen = 0;
+    _tail = _head_seen = 0;
+    _closed = false;
+    _items = (T*) malloc(size * sizeof(T));
+    return _items != NULL;
+}
+
+template <typename T>
+void SpscQueue<T>::destroy() {
+    free(_items);
+}
+
+template <typename T>
+void SpscQueue<T>::copy_in(const uint64_t at, const T* items, const size_t n) {
+    const size_t start = at & _mask;
+    const size_t first = (n < _mask + 1 - start)? n : _mask + 1 - start;
+    memcpy(_items + start, items, first * sizeof(T));
+    memcpy(_items, items + first, (n - first) * sizeof(T));
+}
+
+template <typename T>
+void SpscQueue<T>::copy_out(const uint64_t at, T* items, const size_t n) {
+    const size_t start = at & _mask;
+    const size_t first = (n < _mask + 1 - start)? n : _mask + 1 - start;
+    memcpy(items, _items + start, first * sizeof(T));
+    memcpy(items + first, _items, (n - first) * sizeof(T));
+}
+
+// push as many of the n items as fit, return how many
+template <typename T>
+size_t SpscQueue<T>::push(const T* items, const size_t n) {
+    const uint64_t tail = _tail;
+    size_t room = _mask + 1 - (tail - _head_seen);
+    if (room < n) {
+        _head_seen = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        room = _mask + 1 - (tail - _head_seen);
+    }
+    const size_t count = (n < room)? n : room;
+    if (count == 0) return 0;
+    copy_in(tail, items, count);
+    __atomic_store_n(&_tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+// yield to the consumer until everything is in
+template <typename T>
+void SpscQueue<T>::push_all(const T* items, size_t n) {
+    while (n > 0) {
+        const size_t count = push(items, n);
+        if (count == 0) sched_yield();
+        items += count;
+        n -= count;
+    }
+}
+
+// nothing more will be pushed
+template <typename T>
+void SpscQueue<T>::close() {
+    __atomic_store_n(&_closed, true, __ATOMIC_RELEASE);
+}
+
+// pop up to max items, return how many
+template <typename T>
+size_t SpscQueue<T>::pop(T* items, const size_t max) {
+    const uint64_t head = _head;
+    size_t available = _tail_seen - head;
+    if (available < max) {
+        _tail_seen = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        available = _tail_seen - head;
+    }
+    const size_t count = (max < available)? max : available;
+    if (count == 0) return 0;
+    copy_out(head, items, count);
+    __atomic_store_n(&_head, head + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+// wait for at least one item, 0 once the queue is closed and drained
+template <typename T>
+size_t SpscQueue<T>::pop_wait(T* items, const size_t max) {
+    while (true) {
+        const size_t count = pop(items, max);
+        if (count > 0) return count;
+        // pushes made before close are visible after seeing it
+        if (__atomic_load_n(&_closed, __ATOMIC_ACQUIRE)) return pop(items, max);
+        sched_yield();
+    }
+}
+
+#endif // SPSC_QUEUE_H
@@ -2,72 +2,106 @@
 #define STACK_H
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <utility>
 
-// Simple stack with fixed memory
-// Implement custom allocator if needed
+#include "arena.h"
+
+// Stack starting with room for a size hint, doubling when full.
+// With a good hint push never leaves the fast path. Memory comes from
+// malloc, or from an arena if given one: old blocks then stay in the
+// arena until it's destroyed. T is moved around with memcpy.
+// high_water() tells how deep it went, to tune the hint.
 
 template <class T>
 struct Stack
 {
-    bool init(const int32_t size);
+    bool init(const size_t size, Arena* arena = NULL);
     void destroy();
     bool push(T&&);
     bool push(const T&);
     bool pop(T&);
     bool pop(T&&);
-    inline void clear() { _pos = -1; };
-    inline int32_t size() const { return _pos+1; }
+    inline void clear() { _count = 0; };
+    inline size_t size() const { return _count; }
+    inline size_t capacity() const { return _capacity; }
+    inline size_t high_water() const { return _high_water; }
 private:
-    int32_t _size;
-    int32_t _pos;
+    bool grow();
+    size_t _capacity;
+    size_t _count;
+    size_t _high_water;
     T* _data;
+    Arena* _arena;
 };
 
 template <class T>
-bool Stack<T>::init(const int32_t size) {
+bool Stack<T>::init(const size_t size, Arena* arena) {
     assert(size > 0);
-    _size = size;
-    _pos = -1;
-    _data = (T*) malloc(sizeof(T) * size);
+    _capacity = size;
+    _count = 0;
+    _high_water = 0;
+    _arena = arena;
+    if (_arena != NULL) _data = (T*) _arena->alloc(sizeof(T) * size);
+    else _data = (T*) malloc(sizeof(T) * size);
     return (_data != NULL);
 }
 
 template <class T>
 void Stack<T>::destroy() {
-    free(_data); 
+    if (_arena == NULL) free(_data);
+}
+
+// out of the way of push, only called when full
+template <class T>
+__attribute__((noinline)) bool Stack<T>::grow() {
+    const size_t capacity = (_capacity > 0)? _capacity * 2 : 16;
+    T* data;
+    if (_arena != NULL) {
+        data = (T*) _arena->alloc(sizeof(T) * capacity);
+        if (data != NULL) memcpy((void*) data, (const void*) _data, sizeof(T) * _count);
+    } else {
+        data = (T*) realloc((void*) _data, sizeof(T) * capacity);
+    }
+    if (data == NULL) return false;
+    _data = data;
+    _capacity = capacity;
+    return true;
 }
 
+// false only if growing failed
 template <class T>
 bool Stack<T>::push(const T& val) {
-    if (_pos == _size) return false;
+    if (__builtin_expect(_count == _capacity, 0) && !grow()) return false;
 
-    _data[++_pos] = val;
+    _data[_count++] = val;
+    if (_count > _high_water) _high_water = _count;
     return true;
 }
 
 template <class T>
 bool Stack<T>::push(T&& val) {
-    if (_pos == _size) return false;
+    if (__builtin_expect(_count == _capacity, 0) && !grow()) return false;
 
-    _data[++_pos] = std::move(val);
+    _data[_count++] = std::move(val);
+    if (_count > _high_water) _high_water = _count;
     return true;
 }
 
 template <class T> 
 bool Stack<T>::pop(T&& ret) {
-    if (_pos == -1) return false;
+    if (_count == 0) return false;
 
-    std::swap(ret, _data[_pos]);
-    _pos -= 1;
+    std::swap(ret, _data[--_count]);
     return true;
 }
 
 template <class T> 
 bool Stack<T>::pop(T& ret) {
-    if (_pos == -1) return false;
+    if (_count == 0) return false;
 
-    ret = _data[_pos--] ;
+    ret = _data[--_count];
     return true;
 }
 
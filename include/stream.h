@@ -0,0 +1,246 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "scan.h"
+
+// Line reader for inputs we can't or don't want to load whole.
+// A background thread fills one chunk while the other is being parsed,
+// so memory stays at two chunks plus the longest line crossing them.
+// Works on pipes, use "-" for stdin.
+
+static const size_t STREAM_CHUNK = 1 << 20;
+
+typedef struct Chunk {
+    char* data;
+    size_t size;
+    bool full; // written by the reader, not parsed yet
+    bool last; // nothing comes after this one
+} Chunk;
+
+typedef struct Stream {
+    bool open(const char* path);
+    void close();
+    bool next_line(LineView& line);
+    bool failed() const { return _error; }
+
+private:
+    static void* reader(void* self);
+    bool next_chunk();
+    bool append_carry(const char* str, const size_t size);
+
+    Chunk _chunks[2];
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    int _descriptor;
+    bool _stop;
+    bool _error;
+    bool _done;
+    bool _started;
+    uint8_t _current;
+
+    // position in the chunk being parsed
+    const char* _it;
+    const char* _end;
+
+    // line crossing a chunk boundary
+    char* _carry;
+    size_t _carry_size;
+    size_t _carry_capacity;
+} Stream;
+
+void* Stream::reader(void* self) {
+    Stream* s = (Stream*) self;
+    // only allow cancelling while blocked in read(), see close()
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    uint8_t current = 0;
+    bool done = false;
+    while (!done) {
+        Chunk& chunk = s->_chunks[current];
+        pthread_mutex_lock(&s->_lock);
+        while (chunk.full && !s->_stop) pthread_cond_wait(&s->_cond, &s->_lock);
+        const bool stop = s->_stop;
+        pthread_mutex_unlock(&s->_lock);
+        if (stop) break;
+
+        // pipes give us small pieces, fill the whole chunk anyway
+        size_t size = 0;
+        bool error = false;
+        while (size < STREAM_CHUNK) {
+            pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+            const ssize_t n_read = read(s->_descriptor, chunk.data + size, STREAM_CHUNK - size);
+            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+            if (n_read < 0 && errno == EINTR) continue;
+            if (n_read <= 0) {
+                error = (n_read < 0);
+                done = true;
+                break;
+            }
+            size += n_read;
+        }
+
+        pthread_mutex_lock(&s->_lock);
+        chunk.size = size;
+        chunk.last = done;
+        chunk.full = true;
+        if (error) s->_error = true;
+        pthread_cond_broadcast(&s->_cond);
+        pthread_mutex_unlock(&s->_lock);
+        current ^= 1;
+    }
+    return NULL;
+}
+
+// hand the chunk we're done with back to the reader
+// and wait for the next one
+bool Stream::next_chunk() {
+    if (_done) return false;
+
+    if (_started) {
+        Chunk& parsed = _chunks[_current];
+        // the reader can refill it as soon as we let go
+        const bool last = parsed.last;
+        pthread_mutex_lock(&_lock);
+        parsed.full = false;
+        pthread_cond_broadcast(&_cond);
+        pthread_mutex_unlock(&_lock);
+        if (last) {
+            _done = true;
+            return false;
+        }
+        _current ^= 1;
+    }
+    _started = true;
+
+    Chunk& chunk = _chunks[_current];
+    pthread_mutex_lock(&_lock);
+    while (!chunk.full) pthread_cond_wait(&_cond, &_lock);
+    pthread_mutex_unlock(&_lock);
+
+    _it = chunk.data;
+    _end = chunk.data + chunk.size;
+    return true;
+}
+
+bool Stream::append_carry(const char* str, const size_t size) {
+    if (_carry_size + size > _carry_capacity) {
+        size_t capacity = (_carry_capacity == 0)? 256 : _carry_capacity;
+        while (capacity < _carry_size + size) capacity *= 2;
+        char* carry = (char*) realloc(_carry, capacity);
+        if (carry == NULL) return false;
+        _carry = carry;
+        _carry_capacity = capacity;
+    }
+    memcpy(_carry + _carry_size, str, size);
+    _carry_size += size;
+    return true;
+}
+
+// The view is valid until the next call,
+// the chunk it points to goes back to the reader after that.
+bool Stream::next_line(LineView& line) {
+    _carry_size = 0;
+    while (true) {
+        if (_it == _end) {
+            if (next_chunk()) continue;
+            // input ended without a last line feed
+            if (_carry_size == 0) return false;
+            line.str = _carry;
+            line.size = _carry_size;
+            return true;
+        }
+
+        const char* end = scan_byte(_it, _end, LINE_FEED);
+        if (end == _end) {
+            // line goes on in the next chunk
+            if (!append_carry(_it, _end - _it)) return false;
+            _it = _end;
+            continue;
+        }
+
+        if (_carry_size > 0) {
+            if (!append_carry(_it, end - _it)) return false;
+            line.str = _carry;
+            line.size = _carry_size;
+        } else {
+            line.str = _it;
+            line.size = end - _it;
+        }
+
+        // go over the line ending
+        _it = end + 1;
+        return true;
+    }
+}
+
+bool Stream::open(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        _descriptor = STDIN_FILENO;
+    } else {
+        _descriptor = ::open(path, O_RDONLY);
+        if (_descriptor == -1) return false;
+        // hint only, fails on pipes
+        posix_fadvise(_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    _stop = false;
+    _error = false;
+    _done = false;
+    _started = false;
+    _current = 0;
+    _it = NULL;
+    _end = NULL;
+    _carry = NULL;
+    _carry_size = 0;
+    _carry_capacity = 0;
+
+    bool ok = true;
+    for (uint8_t i = 0; i < 2; ++i) {
+        _chunks[i].data = (char*) malloc(STREAM_CHUNK);
+        _chunks[i].size = 0;
+        _chunks[i].full = false;
+        _chunks[i].last = false;
+        if (_chunks[i].data == NULL) ok = false;
+    }
+    if (!ok) goto beach;
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+    if (pthread_create(&_thread, NULL, reader, this) == 0) return true;
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+beach:
+    free(_chunks[0].data);
+    free(_chunks[1].data);
+    if (_descriptor != STDIN_FILENO) ::close(_descriptor);
+    return false;
+}
+
+void Stream::close() {
+    // the reader might be waiting on us or blocked on a pipe
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_lock);
+    pthread_cancel(_thread);
+    pthread_join(_thread, NULL);
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+    free(_chunks[0].data);
+    free(_chunks[1].data);
+    free(_carry);
+    if (_descriptor != STDIN_FILENO) ::close(_descriptor);
+}
+
+#endif // STREAM_H
@@ -1,6 +1,10 @@
 #ifndef STRTOINT_H
 #define STRTOINT_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 inline int ascii_isdigit(const int c) {
     return (c >= '0' && c <= '9' ? 1 : 0);
 }
@@ -40,4 +44,152 @@ int strtoint(const char* str) {
     return ret;
 }
 
+// same as strtoint, but stops after n chars
+// for strings that are not null terminated
+int strntoint(const char* str, const size_t n) {
+    size_t i = 0;
+    int negative = 0;
+    int ret = 0;
+
+    if (n == 0) return 0;
+    if (str[0] == '-') {
+        negative = 1;
+        ++i;
+    } else if (str[0] == '+') {
+        ++i;
+    }
+
+    while (i < n && ascii_isdigit(str[i])) {
+        ret *= 10; // this can overflow
+        ret += str[i] - '0';
+        ++i;
+    }
+
+    if (negative) ret = -ret;
+    return ret;
+}
+
+// Checked parsing of base 10 integers in [it, end).
+// it is moved past what was parsed, on overflow it still goes past all
+// the digits and value is clamped to the limit of the type.
+// Digits are converted 8 at a time when 8 bytes are left to read.
+
+enum IntParse { INT_OK = 0, INT_EMPTY, INT_OVERFLOW };
+
+static const uint64_t SWAR_ONES = 0x0101010101010101;
+static const uint64_t SWAR_HIGH = 0x8080808080808080;
+
+// number of leading digits in the 8 bytes, no carry crosses a byte:
+// (b & 0x7f) + 0x46 has its high bit set above '9', + 0x50 below '0'
+static inline uint8_t swar_digit_count(const uint64_t chunk) {
+    const uint64_t low = chunk & ~SWAR_HIGH;
+    const uint64_t above = low + 0x46 * SWAR_ONES;
+    const uint64_t below = ~(low + 0x50 * SWAR_ONES);
+    const uint64_t not_digit = (above | below | chunk) & SWAR_HIGH;
+    if (not_digit == 0) return 8;
+    return __builtin_ctzll(not_digit) >> 3;
+}
+
+// up to 8 digits, first one in the lowest byte, zero bytes above n
+static inline uint32_t swar_digits(uint64_t chunk, const uint8_t n) {
+    chunk -= 0x30 * SWAR_ONES;
+    // line the digits up with the top, leading zeros don't change the value
+    chunk <<= (8 - n) * 8;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FF;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFF;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFF;
+    return (uint32_t) chunk;
+}
+
+static const uint64_t POWERS_OF_TEN[9] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+IntParse parse_uint64(const char*& it, const char* end, uint64_t& value) {
+    const char* start = it;
+    bool overflow = false;
+    value = 0;
+
+    while (end - it >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, it, sizeof(chunk));
+        const uint8_t n = swar_digit_count(chunk);
+        if (n == 0) break;
+
+        if (!overflow) {
+            overflow = __builtin_mul_overflow(value, POWERS_OF_TEN[n], &value) ||
+                       __builtin_add_overflow(value, (uint64_t) swar_digits(chunk, n), &value);
+        }
+        it += n;
+        if (n < 8) goto beach;
+    }
+
+    while (it < end && ascii_isdigit(*it)) {
+        if (!overflow) {
+            overflow = __builtin_mul_overflow(value, (uint64_t) 10, &value) ||
+                       __builtin_add_overflow(value, (uint64_t) (*it - '0'), &value);
+        }
+        ++it;
+    }
+
+beach:
+    if (overflow) {
+        value = UINT64_MAX;
+        return INT_OVERFLOW;
+    }
+    return (it == start)? INT_EMPTY : INT_OK;
+}
+
+// optional sign in front
+IntParse parse_int64(const char*& it, const char* end, int64_t& value) {
+    const char* start = it;
+    bool negative = false;
+    if (it < end && (*it == '-' || *it == '+')) {
+        negative = (*it == '-');
+        ++it;
+    }
+
+    uint64_t magnitude;
+    IntParse ret = parse_uint64(it, end, magnitude);
+    if (ret == INT_EMPTY) {
+        it = start;
+        value = 0;
+        return ret;
+    }
+
+    const uint64_t limit = (uint64_t) INT64_MAX + (negative? 1 : 0);
+    if (ret == INT_OVERFLOW || magnitude > limit) {
+        value = negative? INT64_MIN : INT64_MAX;
+        return INT_OVERFLOW;
+    }
+    value = negative? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+    return INT_OK;
+}
+
+IntParse parse_uint32(const char*& it, const char* end, uint32_t& value) {
+    uint64_t wide;
+    const IntParse ret = parse_uint64(it, end, wide);
+    if (ret == INT_OVERFLOW || wide > UINT32_MAX) {
+        value = UINT32_MAX;
+        return INT_OVERFLOW;
+    }
+    value = wide;
+    return ret;
+}
+
+IntParse parse_int32(const char*& it, const char* end, int32_t& value) {
+    int64_t wide;
+    const IntParse ret = parse_int64(it, end, wide);
+    if (wide > INT32_MAX) {
+        value = INT32_MAX;
+        return INT_OVERFLOW;
+    }
+    if (wide < INT32_MIN) {
+        value = INT32_MIN;
+        return INT_OVERFLOW;
+    }
+    value = wide;
+    return ret;
+}
+
 # endif // STRTOINT_H
@@ -18,7 +18,7 @@ void cycle_begin() {
 }
 
 uint64_t cycle_stop() {
-    return cycle_start - __rdtsc();
+    return __rdtsc() - cycle_start;
 }
 
 // TODO, support Windows with QueryPerformanceCounter
@@ -28,16 +28,16 @@ uint64_t cycle_stop() {
 
 #include <time.h>
 
-static struct timespec start, stop;
+static struct timespec timer_begin, timer_end;
 
 static void timer_start() {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &timer_begin);
 }
 
 // this is µs
 static uint64_t timer_stop() {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &stop);
-    return (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_nsec - start.tv_nsec) / 1000;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &timer_end);
+    return (timer_end.tv_sec - timer_begin.tv_sec) * 1000000 + (timer_end.tv_nsec - timer_begin.tv_nsec) / 1000;
 }
 
 #endif // _WIN32
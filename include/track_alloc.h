@@ -0,0 +1,132 @@
+#ifndef TRACK_ALLOC_H
+#define TRACK_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+// Allocation accounting, built in with -DTRACK_ALLOC only
+// (TRACK_ALLOC=1 ./build.sh). malloc and friends are replaced for the
+// whole program, libc and libstdc++ included, and forward to glibc's own
+// __libc_ versions. new and delete go through malloc and free, so they
+// are counted too. Sizes are what malloc_usable_size says, what a block
+// really holds, so a free takes off exactly what its allocation added.
+// Counters are atomic, threads can allocate.
+// The profiler reads them per phase, see profile.h.
+
+typedef struct AllocStats {
+    uint64_t count; // allocations
+    uint64_t bytes; // allocated, frees don't take it back
+    uint64_t live;
+    uint64_t peak; // highest live since the last alloc_peak_reset
+} AllocStats;
+
+static AllocStats alloc_stats;
+
+// in KB, for the whole process so far
+static inline uint64_t alloc_max_rss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+#ifdef TRACK_ALLOC
+
+#include <errno.h>
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+static inline void alloc_add(void* p) {
+    if (p == NULL) return;
+    const uint64_t size = malloc_usable_size(p);
+    __atomic_add_fetch(&alloc_stats.count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_stats.bytes, size, __ATOMIC_RELAXED);
+    const uint64_t live = __atomic_add_fetch(&alloc_stats.live, size, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&alloc_stats.peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&alloc_stats.peak, &peak, live, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static inline void alloc_remove(void* p) {
+    if (p == NULL) return;
+    __atomic_sub_fetch(&alloc_stats.live, (uint64_t) malloc_usable_size(p), __ATOMIC_RELAXED);
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    alloc_add(p);
+    return p;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* p = __libc_calloc(n, size);
+    alloc_add(p);
+    return p;
+}
+
+// counts as one allocation of the new size
+void* realloc(void* p, size_t size) {
+    const uint64_t before = (p == NULL)? 0 : malloc_usable_size(p);
+    if (p != NULL && size == 0) {
+        alloc_remove(p);
+        __libc_free(p);
+        return NULL;
+    }
+    void* q = __libc_realloc(p, size);
+    if (q == NULL) return NULL;
+    __atomic_sub_fetch(&alloc_stats.live, before, __ATOMIC_RELAXED);
+    alloc_add(q);
+    return q;
+}
+
+void free(void* p) {
+    alloc_remove(p);
+    __libc_free(p);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void* p = __libc_memalign(alignment, size);
+    alloc_add(p);
+    return p;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    void* p = memalign(alignment, size);
+    if (p == NULL) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+} // extern "C"
+
+#endif // TRACK_ALLOC
+
+// returns the peak to restore with alloc_peak_restore, so phases can nest
+static inline uint64_t alloc_peak_reset() {
+    const uint64_t peak = __atomic_load_n(&alloc_stats.peak, __ATOMIC_RELAXED);
+    __atomic_store_n(&alloc_stats.peak, __atomic_load_n(&alloc_stats.live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    return peak;
+}
+
+// the outer peak is at least what we saw inside
+static inline void alloc_peak_restore(const uint64_t outer) {
+    uint64_t peak = __atomic_load_n(&alloc_stats.peak, __ATOMIC_RELAXED);
+    while (outer > peak && !__atomic_compare_exchange_n(&alloc_stats.peak, &peak, outer, true,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+#endif // TRACK_ALLOC_H
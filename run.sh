@@ -10,6 +10,19 @@ if [ -n "${2+set}" ]; then
   RANGE="$1 $2"
 fi
 
+# read all inputs at once before the days ask for them one by one
+INPUTS=""
+for i in `seq $RANGE`;
+do
+    if [ -f input/day$i ]; then
+        INPUTS="${INPUTS} input/day$i"
+    fi
+done
+if [ -x out/preload ] && [ -n "${INPUTS}" ]; then
+    out/preload ${INPUTS}
+    echo ""
+fi
+
 for i in `seq $RANGE`;
 do
     echo "Running Day $i"
@@ -1,13 +1,13 @@
 #include <stdio.h>
 
-#include "file.h"
+#include "bench.h"
+#include "profile.h"
+#include "stream.h"
 #include "ring_buffer.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const size_t LINE_LENGTH = 8;
-
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -16,24 +16,30 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    File file;
-    if(file.open(argv[1]) == false) {
+    Stream stream;
+    profile_begin("read");
+    if(stream.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
     Ringbuffer<int> ring_buffer;
-    ring_buffer.init(3);
+    if (!ring_buffer.init(3)) {
+        printf("Couldn't allocate window.\n");
+        return -1;
+    }
 
-    char str[LINE_LENGTH];
+    LineView line;
     int larger = 0;
     int larger_sums = 0;
     int last_sum = 0;
     int line_count = 0;
 
-    while (file.readline(str, LINE_LENGTH)) {
+    profile_begin("parse");
+    while (stream.next_line(line)) {
         ++line_count;
-        const int depth = strtoint(str);
+        const int depth = strntoint(line.str, line.size);
         if (line_count > 1 && ring_buffer.last() < depth) ++larger;
 
         ring_buffer.push(depth);
@@ -43,14 +49,27 @@ int main(int argc, char **argv)
             last_sum = sum;
         }
     }
+    profile_end();
+    if (stream.failed()) {
+        printf("Couldn't read file %s\n", argv[1]);
+        return -1;
+    }
 
-    file.close();
+    stream.close();
     ring_buffer.free();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 1 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Larger measurement: %i\n", larger);
     printf("Larger 3 sums measurement: %i\n", larger_sums);
+    report_answer("%i", larger);
+    report_answer("%i", larger_sums);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,15 +1,17 @@
 #include <stdio.h>
 
-#include "file.h"
-#include "radix_sort64.h"
+#include "bench.h"
+#include "profile.h"
+#include "stream.h"
+#include "radix_sort.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 128;
 static const uint8_t MAX_INCOMPLETE = 64;
+static const uint16_t MAX_DEPTH = 256;
 
 typedef struct Parser {
     void init();
-    bool parse_line(char* buf);
+    bool parse_line(const LineView& line);
 
     uint32_t error_score() const { return _error_score; }
     uint64_t completion_score();
@@ -23,21 +25,23 @@ private:
 
 uint64_t Parser::completion_score() {
     if (_n_incomplete == 0) return 0;
-    // BETTER, is there a faster way to find middle score than sorting?
-    radix_sort64(_completion_scores, _n_incomplete);
-    return _completion_scores[_n_incomplete/2];
+    // the middle one, the rest can stay unsorted
+    return radix_select(_completion_scores, _n_incomplete, _n_incomplete/2);
 }
 
-bool Parser::parse_line(char* str) {
+bool Parser::parse_line(const LineView& line) {
+    // opened chunks waiting to be closed
+    char str[MAX_DEPTH];
     size_t it = 0;
     size_t depth = 0;
-    while (str[it] != '\0') {
-        switch (str[it]) {
+    while (it < line.size) {
+        switch (line.str[it]) {
             case '(':
             case '[':
             case '{':
             case '<':
-                str[depth++] = str[it];
+                if (depth == MAX_DEPTH) return false;
+                str[depth++] = line.str[it];
                 break;
             case ')':
                 if (depth == 0 || str[--depth] != '(') {
@@ -90,7 +94,7 @@ void Parser::init() {
     _n_incomplete = 0;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -102,29 +106,47 @@ int main(int argc, char **argv)
     Parser parser;
     parser.init();
 
-    File file;
-    if(file.open(argv[1]) == false) {
+    Stream stream;
+    profile_begin("read");
+    if(stream.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!parser.parse_line(str)) {
+    LineView line;
+    profile_begin("parse");
+    while (stream.next_line(line)) {
+        if (!parser.parse_line(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
+    profile_end();
+    if (stream.failed()) {
+        printf("Couldn't read file %s\n", argv[1]);
+        return -1;
+    }
 
+    profile_begin("solve");
     const uint32_t answer1 = parser.error_score();
     const uint64_t answer2 = parser.completion_score();
+    profile_end();
 
-    file.close();
+    stream.close();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 10 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %" PRIu64 "\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%" PRIu64, answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
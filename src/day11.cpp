@@ -1,11 +1,12 @@
 #include <stdio.h>
 
+#include "bench.h"
 #include "file.h"
+#include "profile.h"
 #include "stack.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 11;
 static const uint8_t OCTO_MAX = 100;
 static const uint8_t SIDE_SIZE = 10;
 static const uint8_t FLASH_THRESHOLD = 9;
@@ -14,12 +15,12 @@ static const uint8_t BOTTOM_IDX = (SIDE_SIZE*(SIDE_SIZE-1));
 
 // A group of octopuses is called a consortium
 typedef struct Consortium {
-    void init();
+    bool init();
     void destroy();
-    bool add_line(const char* str);
-    uint16_t step_n(const uint16_t n_steps);
+    bool add_line(const LineView& line);
+    bool step_n(const uint16_t n_steps, uint16_t* n_done);
     uint16_t flashes() const { return _n_flashes; }
-    uint16_t step_until_sync();
+    bool step_until_sync(uint16_t* steps);
 
 private:
     bool add_visit(const uint8_t n);
@@ -30,29 +31,22 @@ private:
 
 } Consortium;
 
-bool Consortium::add_line(const char* str) {
-    uint8_t it = 0;
+bool Consortium::add_line(const LineView& line) {
     if (_n_row >= SIDE_SIZE) return false;
+    if (line.size > SIDE_SIZE) return false;
     const uint8_t line_idx = _n_row*SIDE_SIZE;
-    while (true) {
-        if (str[it] == '\0') {
-            break;
-        } else if (ascii_isdigit(str[it])) {
-            if (it >= SIDE_SIZE) return false;
-            _octopuses[line_idx + it] = str[it] - '0';
-        } else {
-            return false;
-        }
-        ++it;
+    for (uint8_t it = 0; it < line.size; ++it) {
+        if (!ascii_isdigit(line.str[it])) return false;
+        _octopuses[line_idx + it] = line.str[it] - '0';
     }
     _n_row++;
     return true;
 }
 
-void Consortium::init() {
+bool Consortium::init() {
     _n_row = 0;
     _n_flashes = 0;
-    _stack.init(128);
+    return _stack.init(128);
 }
 
 void Consortium::destroy() {
@@ -67,17 +61,20 @@ bool Consortium::add_visit(const uint8_t n) {
     return true;
 }
 
-uint16_t Consortium::step_until_sync() {
+bool Consortium::step_until_sync(uint16_t* steps) {
     // we already did 100
-    uint16_t steps = 100;
-    steps += step_n(65535); // loop for as long as we can
-
-    return steps;
+    uint16_t n_done;
+    if (!step_n(65535, &n_done)) return false; // loop for as long as we can
+    *steps = 100 + n_done;
+    return true;
 }
 
-uint16_t Consortium::step_n(const uint16_t n_steps) {
-    if (_n_row != SIDE_SIZE) return false;
+// false if the stack couldn't grow, n_done is how many steps ran
+bool Consortium::step_n(const uint16_t n_steps, uint16_t* n_done) {
+    *n_done = 0;
+    if (_n_row != SIDE_SIZE) return true;
 
+    bool ok = true;
     uint16_t step;
     for (step = 0; step < n_steps; ++step) {
         int step_flashes = 0;
@@ -85,7 +82,7 @@ uint16_t Consortium::step_n(const uint16_t n_steps) {
         for (uint8_t i = 0; i < OCTO_MAX; ++i) {
             _octopuses[i] += 1;
             if(_octopuses[i] > FLASH_THRESHOLD) {
-                _stack.push(i);
+                ok &= _stack.push(i);
             }
         }
         // handle flashes
@@ -104,29 +101,34 @@ uint16_t Consortium::step_n(const uint16_t n_steps) {
             const bool has_down = (n < BOTTOM_IDX);
             // handle top
             if (has_top) {
-                add_visit(n-SIDE_SIZE);
-                if (has_left) add_visit(n-SIDE_SIZE-1);
-                if (has_right) add_visit(n-SIDE_SIZE+1);
+                ok &= add_visit(n-SIDE_SIZE);
+                if (has_left) ok &= add_visit(n-SIDE_SIZE-1);
+                if (has_right) ok &= add_visit(n-SIDE_SIZE+1);
             }
             // handle bottom
             if (has_down) {
-                add_visit(n+SIDE_SIZE);
-                if (has_left) add_visit(n+SIDE_SIZE-1);
-                if (has_right) add_visit(n+SIDE_SIZE+1);
+                ok &= add_visit(n+SIDE_SIZE);
+                if (has_left) ok &= add_visit(n+SIDE_SIZE-1);
+                if (has_right) ok &= add_visit(n+SIDE_SIZE+1);
             }
             // handle sides
-            if (has_left) add_visit(n-1);
-            if (has_right) add_visit(n+1);
+            if (has_left) ok &= add_visit(n-1);
+            if (has_right) ok &= add_visit(n+1);
         }
+        if (!ok) return false;
 
         _n_flashes += step_flashes;
         // return for Part 2 if all octopuses flashed
-        if (step_flashes == OCTO_MAX) return step+1;
+        if (step_flashes == OCTO_MAX) {
+            *n_done = step+1;
+            return true;
+        }
     }
-    return step;
+    *n_done = step;
+    return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -136,25 +138,45 @@ int main(int argc, char **argv)
     }
 
     Consortium consortium;
-    consortium.init();
+    if (!consortium.init()) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!consortium.add_line(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!consortium.add_line(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
-    if (consortium.step_n(100) != 100) return -1;
+    profile_end();
+    profile_begin("part1");
+    uint16_t n_done;
+    if (!consortium.step_n(100, &n_done)) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
+    if (n_done != 100) return -1;
     const uint16_t answer1 = consortium.flashes();
-    const uint16_t answer2 = consortium.step_until_sync();
+    profile_end();
+    profile_begin("part2");
+    uint16_t answer2;
+    if (!consortium.step_until_sync(&answer2)) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
+    profile_end();
 
     file.close();
     consortium.destroy();
@@ -163,6 +185,14 @@ int main(int argc, char **argv)
     printf("Day 11 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,10 +1,11 @@
 #include <stdio.h>
 
+#include "bench.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 16;
 static const uint8_t CONNECTIONS_MAX = 16;
 
 // BETTER, check if using the smallest possible array
@@ -27,7 +28,7 @@ typedef struct Map {
     Map() : _connection_count{0}, _visit_count{0} { }
     void init();
 
-    bool add_node(const char* str);
+    bool add_node(const LineView& line);
     void calc_paths();
 
     uint16_t simple_visit_count;
@@ -84,12 +85,14 @@ void Map::calc_paths() {
     recurse_count(START, false);
 }
 
-bool Map::add_node(const char* str) {
-    uint8_t it = 0;
+bool Map::add_node(const LineView& line) {
+    const char* str = line.str;
+    size_t it = 0;
     char node_str[2];
     uint16_t node_a, node_b;
 
-    // TODO make this safe
+    // shortest line is "xx-yy"
+    if (line.size < 5) return false;
     if (str[2] == '-') {
         const bool is_large = ascii_islarge(str[0]);
         node_str[0] = (is_large)? str[0] : str[0] - 32;
@@ -106,10 +109,9 @@ bool Map::add_node(const char* str) {
     } else {
         return false;
     }
-    const uint8_t it_hyphen = it;
-    while (str[it] != '\0') ++it;
-
-    const uint8_t char_left =  it - it_hyphen;
+    if (it > line.size) return false;
+    const size_t char_left = line.size - it;
+    const size_t it_hyphen = it;
     if (char_left == 2) {
         const bool is_large = ascii_islarge(str[it_hyphen]);
         node_str[0] = (is_large)? str[it_hyphen] : str[it_hyphen] - 32;
@@ -131,7 +133,7 @@ bool Map::add_node(const char* str) {
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -144,20 +146,26 @@ int main(int argc, char **argv)
     map.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 5) {
-        if (!map.add_node(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line) && line.size > 4) {
+        if (!map.add_node(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("solve");
     map.calc_paths();
+    profile_end();
 
     const uint16_t answer1 = map.simple_visit_count;
     const uint32_t answer2 = map.part_two_count;
@@ -168,6 +176,14 @@ int main(int argc, char **argv)
     printf("Day 12 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
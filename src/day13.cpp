@@ -2,14 +2,18 @@
 #include <string.h>
 #include <unordered_set>
 
+#include "bench.h"
+#include "cache.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 32;
 static const uint16_t MAX_X = 1311;
 static const uint16_t MAX_Y = 895;
 static const uint32_t MAX_DOTS = 866;
+static const uint16_t MAX_FOLDS = 32;
+static const uint32_t CACHE_VERSION = 1; // bump when Dot or Fold change
 
 typedef struct Dot {
     uint16_t x;
@@ -19,6 +23,11 @@ typedef struct Dot {
     }
 } Dot;
 
+typedef struct Fold {
+    uint16_t axis;
+    uint16_t value;
+} Fold;
+
 struct hash_func {
     size_t operator() (const Dot& d) const {
         return d.x + d.y * MAX_X;
@@ -28,8 +37,12 @@ struct hash_func {
 typedef struct Paper {
     void init();
 
-    bool add_dot(const char* str);
-    bool fold(const char* str);
+    bool add_dot(const LineView& line);
+    bool add_fold(const LineView& line);
+    void fold(const uint16_t index);
+    uint16_t fold_count() const { return _n_folds; }
+    bool load(const Cache& cache);
+    bool save(const char* input) const;
     void print_all() const;
     uint32_t visible_count();
 
@@ -38,6 +51,8 @@ private:
     uint16_t _actual_x;
     uint16_t _actual_y;
     uint16_t _n_points;
+    Fold _folds[MAX_FOLDS];
+    uint16_t _n_folds;
     // we use a set to remove duplicate dots
     // BETTER, don't use std
     std::unordered_set<Dot, hash_func> _set;
@@ -48,6 +63,7 @@ void Paper::init() {
     _actual_x = MAX_X;
     _actual_y = MAX_Y;
     _n_points = 0;
+    _n_folds = 0;
     _set.reserve(MAX_DOTS);
 }
 
@@ -82,32 +98,38 @@ void Paper::print_all() const {
 // expecting:
 // fold along y=7
 // fold along x=5
-bool Paper::fold(const char* str) {
+bool Paper::add_fold(const LineView& line) {
+    const char* str = line.str;
     // let's assume we receive valid data beyond this
-    if (str[0] != 'f') return false;
+    if (line.size == 0 || str[0] != 'f') return false;
+    if (_n_folds == MAX_FOLDS) return false;
 
     size_t it = 0;
     char axis = 0;
-    while (str[it] != '\0') {
+    while (it < line.size) {
         if (str[it] =='x' || str[it] == 'y') break;
         ++it;
     }
+    if (it == line.size) return false;
 
     axis = str[it];
-    it += 2; // unsafe
-
-    uint16_t value = 0;
-    while (str[it] != '\0') {
-        if (ascii_isdigit(str[it])) {
-            const char c = str[it] - '0';
-            value *= 10; // this can overflow
-            value += c;
-        }
-        ++it;
-    }
+    it += 2; // skip "x="
+    if (it > line.size) return false;
+
+    const char* cursor = str + it;
+    uint32_t value;
+    if (parse_uint32(cursor, str + line.size, value) != INT_OK || value > UINT16_MAX) return false;
 
+    _folds[_n_folds].axis = axis;
+    _folds[_n_folds].value = value;
+    ++_n_folds;
+    return true;
+}
+
+void Paper::fold(const uint16_t index) {
+    const uint16_t value = _folds[index].value;
     // BETTER, check if removing the duplicate dots is faster
-    if (axis == 'y') {
+    if (_folds[index].axis == 'y') {
         for (uint16_t i = 0; i < _n_points; ++i) {
             if (_dots[i].y <= value) continue;
             _dots[i].y = value - (_dots[i].y - value);
@@ -120,26 +142,15 @@ bool Paper::fold(const char* str) {
         }
         _actual_x = value;
     }
-    return true;
 }
 
-bool Paper::add_dot(const char* str) {
-    size_t it = 0;
-    uint16_t value[2] = { 0 };
-    for (uint16_t i = 0; i < 2; ++i) {
-        while (str[it] != '\0') {
-            if (str[it] == ',') {
-                ++it;
-                break;
-            }
-            if (ascii_isdigit(str[it])) {
-                const char c = str[it] - '0';
-                value[i] *= 10; // this can overflow
-                value[i] += c;
-            }
-            ++it;
-        }
-    }
+bool Paper::add_dot(const LineView& line) {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    uint32_t value[2];
+    if (parse_uint32(it, end, value[0]) != INT_OK || value[0] > UINT16_MAX) return false;
+    if (it == end || *it++ != ',') return false;
+    if (parse_uint32(it, end, value[1]) != INT_OK || value[1] > UINT16_MAX) return false;
 
     if (_n_points == MAX_DOTS) return false;
     _dots[_n_points].x = value[0];
@@ -148,7 +159,57 @@ bool Paper::add_dot(const char* str) {
     return true;
 }
 
-int main(int argc, char **argv)
+// cached as the dot and fold counts followed by the dots and folds
+bool Paper::load(const Cache& cache) {
+    uint64_t n[2];
+    if (cache.size() < sizeof(n)) return false;
+    memcpy(n, cache.data(), sizeof(n));
+    if (n[0] > MAX_DOTS || n[1] > MAX_FOLDS) return false;
+    if (cache.size() != sizeof(n) + n[0] * sizeof(Dot) + n[1] * sizeof(Fold)) return false;
+
+    const char* data = cache.data() + sizeof(n);
+    memcpy(_dots, data, n[0] * sizeof(Dot));
+    memcpy(_folds, data + n[0] * sizeof(Dot), n[1] * sizeof(Fold));
+    _n_points = n[0];
+    _n_folds = n[1];
+    return true;
+}
+
+bool Paper::save(const char* input) const {
+    const uint64_t n[2] = { _n_points, _n_folds };
+    const CacheSection sections[3] = {
+        { n, sizeof(n) },
+        { _dots, n[0] * sizeof(Dot) },
+        { _folds, n[1] * sizeof(Fold) },
+    };
+    return cache_save(input, CACHE_VERSION, sections, 3);
+}
+
+static bool read_input(const char* path, Paper& paper) {
+    File file;
+    if(file.open(path) == false) {
+        printf("Couldn't read file %s\n", path);
+        return false;
+    }
+
+    LineView line;
+    while (file.next_line(line) && line.size > 0) {
+        if (!paper.add_dot(line)) {
+            printf("Error with input.\n");
+            file.close();
+            return false;
+        }
+    }
+
+    while (file.next_line(line)) {
+        paper.add_fold(line);
+    }
+
+    file.close();
+    return true;
+}
+
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -160,39 +221,50 @@ int main(int argc, char **argv)
     Paper paper;
     paper.init();
 
-    File file;
-    if(file.open(argv[1]) == false) {
-        printf("Couldn't read file %s\n", argv[1]);
-        return -1;
+    profile_begin("load");
+    const bool use_cache = cache_enabled();
+    Cache cache;
+    bool loaded = false;
+    if (use_cache && cache.open(argv[1], CACHE_VERSION)) {
+        loaded = paper.load(cache);
+        cache.close();
+        // a sidecar that doesn't fit is parsed again and replaced
+        if (!loaded) printf("Ignoring the cache of %s\n", argv[1]);
     }
-
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 1) {
-        if (!paper.add_dot(str)) {
-            printf("Error with input.\n");
-            return -1;
-        }
+    if (!loaded) {
+        if (!read_input(argv[1], paper)) return -1;
+        if (use_cache) paper.save(argv[1]);
     }
+    profile_end();
 
+    profile_begin("part1");
     // one instruction
-    if(file.readline(str, INPUT_MAX)) paper.fold(str);
+    if (paper.fold_count() > 0) paper.fold(0);
     const uint32_t answer1 = paper.visible_count();
+    profile_end();
 
+    profile_begin("part2");
     // fold the rest
-    while (file.readline(str, INPUT_MAX)) {
-        paper.fold(str);
+    for (uint16_t i = 1; i < paper.fold_count(); ++i) {
+        paper.fold(i);
     }
 
-    file.close();
-
     printf("Answer 1 = %u\n", answer1);
+    report_answer("%u", answer1);
     printf("Answer 2 =\n");
     paper.print_all();
+    profile_end();
 
     // For this problem, printing is part of the answer and might not be trivial,
     // so we stop timer after.
     const uint64_t completion_time = timer_stop();
     printf("Day 13 completion time: %" PRIu64 "µs\n", completion_time);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
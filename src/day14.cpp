@@ -1,12 +1,13 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
 #include "file.h"
-#include "radix_sort64.h"
+#include "profile.h"
+#include "radix_sort.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 32;
 static const uint8_t ALPHABET_SIZE = 26;
 static const uint16_t MAX_PAIRS = ALPHABET_SIZE * ALPHABET_SIZE;
 
@@ -17,8 +18,8 @@ uint16_t hash(const char a, const char b) {
 typedef struct Polymer {
     void init();
     void destroy();
-    bool add_rule(const char* str);
-    bool add_template(const char* str);
+    bool add_rule(const LineView& line);
+    bool add_template(const LineView& line);
     void step_n(const uint8_t n);
     uint64_t score() const;
 
@@ -40,44 +41,43 @@ void Polymer::destroy() {
 }
 
 uint64_t Polymer::score() const {
-    uint64_t sorted_count[ALPHABET_SIZE];
-    memcpy(sorted_count, _letter_count, sizeof(_letter_count));
-    radix_sort64(sorted_count, ALPHABET_SIZE);
+    // letters from least to most common
+    uint8_t order[ALPHABET_SIZE];
+    radix_argsort(_letter_count, ALPHABET_SIZE, order);
 
     // highest will always be last position but
     // if we don't have 26 letters, smallest non zero
     // might be further up
+    const uint64_t highest = _letter_count[order[ALPHABET_SIZE - 1]];
     for (uint8_t i = 0; i < ALPHABET_SIZE; ++i) {
-        if (sorted_count[i] == 0) continue;
-        return sorted_count[ALPHABET_SIZE - 1] - sorted_count[i];
+        const uint64_t count = _letter_count[order[i]];
+        if (count == 0) continue;
+        return highest - count;
     }
     return 0;
 }
 
 // Expected sequence:
 // BSONBHNSSCFPSFOPHKPK
-bool Polymer::add_template(const char* str) {
-    uint8_t it = 0;
-    while (str[it] != 0) {
+bool Polymer::add_template(const LineView& line) {
+    const char* str = line.str;
+    for (size_t it = 0; it < line.size; ++it) {
         const uint8_t ascii_0 = str[it] - 'A';
         if (ascii_0 >= ALPHABET_SIZE) return false;
         _letter_count[ascii_0] += 1;
 
-        if (str[it+1] == 0) break;
+        if (it + 1 == line.size) break;
         _pairs_count[hash(str[it], str[it+1])] += 1;
-        ++it;
     }
     return true;
 }
 
 // they all have the same size
 // HH -> K
-bool Polymer::add_rule(const char* str) {
-    uint8_t it = 0;
-    while (str[it] != 0) ++it;
-    if (it < 6) return false;
+bool Polymer::add_rule(const LineView& line) {
+    if (line.size < 7) return false;
 
-    _rules[hash(str[0], str[1])] = str[6];
+    _rules[hash(line.str[0], line.str[1])] = line.str[6];
     return true;
 }
 
@@ -117,7 +117,7 @@ void Polymer::step_n(const uint8_t n) {
     }
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -130,31 +130,38 @@ int main(int argc, char **argv)
     polymer.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    file.readline(str, INPUT_MAX);
-    polymer.add_template(str);
+    profile_begin("parse");
+    LineView line;
+    if (file.next_line(line)) polymer.add_template(line);
 
     // skip empty line
-    file.readline(str, INPUT_MAX);
+    file.next_line(line);
 
-    while (file.readline(str, INPUT_MAX)) {
-        if (!polymer.add_rule(str)) {
+    while (file.next_line(line)) {
+        if (!polymer.add_rule(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("part1");
     polymer.step_n(10);
     const uint64_t answer1 = polymer.score();
+    profile_end();
 
     // need 40 steps total
+    profile_begin("part2");
     polymer.step_n(30);
     const uint64_t answer2 = polymer.score();
+    profile_end();
 
     file.close();
     polymer.destroy();
@@ -164,6 +171,14 @@ int main(int argc, char **argv)
 
     printf("Answer 1 = %" PRIu64 "\n", answer1);
     printf("Answer 1 = %" PRIu64 "\n", answer2);
+    report_answer("%" PRIu64, answer1);
+    report_answer("%" PRIu64, answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
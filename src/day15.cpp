@@ -1,132 +1,146 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
 #include "file.h"
 #include "priority_queue.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 128;
-static const uint8_t Y_MAX = 10;
-static const uint8_t X_MAX = 10;
-static const uint16_t X_MAX_REAL = X_MAX * 25;
-static const uint16_t Y_MAX_REAL = Y_MAX * 25;
-static const uint16_t MAX_CHITONS = Y_MAX * X_MAX;
-
-typedef struct Pos {
-    Pos(const uint16_t in_x, const uint16_t in_y) : x(in_x), y(in_y) {}
-    Pos() {}
-    uint16_t x,y;
-    bool operator== (const Pos& p) const {
-        return x == p.x && y == p.y;
-    }
-} Pos;
-
-uint16_t hash(const uint16_t a, const uint16_t b) {
-    return a + b * X_MAX;
-}
+// a step never costs more than the risk of a chiton
+static const uint8_t MAX_RISK = 9;
+static const uint8_t EXPAND_TIMES = 5;
+static const uint32_t UNVISITED = 0xFFFFFFFF;
 
 typedef struct Cave {
     void init();
     void destroy();
-    bool add_row(const char* str);
-    uint16_t lowest_risk(const uint16_t max_x, const uint16_t max_y);
-
-    uint16_t _max_x;
-    uint16_t _max_y;
+    bool add_row(const LineView& line);
+    bool expand(const uint8_t times);
+    bool lowest_risk(uint32_t& risk);
 
 private:
-    void visit(const uint16_t to_x, const uint16_t to_y, const uint16_t hash_from);
+    bool visit(const uint32_t to, const uint32_t cost_from);
 
-    uint16_t _cost_for[MAX_CHITONS];
-    uint8_t _chitons[MAX_CHITONS];
-    uint8_t _y;
-    PriorityQueue<uint16_t> _to_visit;
+    uint8_t* _chitons;
+    uint32_t* _cost_for;
+    uint32_t _width;
+    uint32_t _height;
+    size_t _capacity;
+    PriorityQueue<uint32_t> _to_visit;
 
 } Cave;
 
 void Cave::init() {
-    _max_x = X_MAX; // FIXME
-    _max_y = Y_MAX; // FIXME
-    _y = 0;
-    memset(_cost_for, 0, sizeof(_cost_for));
-    _to_visit.init(128);
+    _chitons = NULL;
+    _cost_for = NULL;
+    _width = 0;
+    _height = 0;
+    _capacity = 0;
 }
 
 void Cave::destroy() {
-    // nothing
+    free(_chitons);
+    free(_cost_for);
 }
 
-// TODO, check if using a grid 25x larger is faster than
-// calculating risk over and over
-uint8_t risk_at(const uint16_t x, const uint16_t y) {
-    (void) x;
-    (void) y;
-    // loop around to 25 times X_MAX, Y_MAX
-    // increasing risk +1 and looping at 9 -> 1
+// Each tile to the right or down is the one before with risks + 1,
+// wrapping from 9 back to 1.
+// We build the larger grid once instead of working out risks on the fly.
+bool Cave::expand(const uint8_t times) {
+    const uint32_t width = _width * times;
+    const uint32_t height = _height * times;
+    uint8_t* chitons = (uint8_t*) malloc((size_t) width * height);
+    if (chitons == NULL) return false;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* row = _chitons + (size_t) (y % _height) * _width;
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t risk = row[x % _width] + y / _height + x / _width;
+            chitons[(size_t) y * width + x] = (risk - 1) % MAX_RISK + 1;
+        }
+    }
 
-    return 0;
+    free(_chitons);
+    _chitons = chitons;
+    _capacity = (size_t) width * height;
+    _width = width;
+    _height = height;
+    return true;
 }
 
-void Cave::visit(const uint16_t to_x, const uint16_t to_y, const uint16_t cost_from) {
-    const uint16_t hash_to = hash(to_x, to_y);
-
-    // cost for going to that new pos
-    const uint16_t new_cost =  cost_from + _chitons[hash_to];
-
-    //printf("    -> %u,%u %u < %u?\n", to_x, to_y, new_cost, _cost_for[hash_to]);
-
-    // visit if it's better than what we have for that pos already
-    if (_cost_for[hash_to] == 0 || new_cost < _cost_for[hash_to]) {
-        _cost_for[hash_to] = new_cost;
-
-        //printf("Pushing %u,%u cost %u\n", to_x,to_y, new_cost);
-        // FIXME, the priority queue is busted
-        _to_visit.push(hash_to, new_cost);
-    }
+// visit if it's better than what we have for that pos already
+bool Cave::visit(const uint32_t to, const uint32_t cost_from) {
+    const uint32_t new_cost = cost_from + _chitons[to];
+    if (new_cost >= _cost_for[to]) return true;
+    _cost_for[to] = new_cost;
+    return _to_visit.push(to, new_cost);
 }
 
-uint16_t Cave::lowest_risk(const uint16_t max_x, const uint16_t max_y) {
-    _to_visit.push(0, 0);
-    uint16_t goal = hash(max_x - 1, max_y - 1);
-
-    uint16_t hash_pos;
-    while (_to_visit.pop(hash_pos)) {
-        const uint16_t x = hash_pos % X_MAX;
-        const uint16_t y = hash_pos / X_MAX;
-        const uint16_t cost = _cost_for[hash_pos];
-
-        //printf("\nVisiting %u,%u \n",x, y);
-
-        // try the 4 neighbors
-        if (x != 0) visit(x-1, y, cost);
-        if (y != 0) visit(x, y-1, cost);
-        if (x != X_MAX -1) visit(x+1, y, cost);
-        if (y != Y_MAX -1) visit(x, y+1, cost);
-
-        if (hash_pos == goal) break;
-
-        //_to_visit.print();
+// Dijkstra from the top left to the bottom right.
+// A position can be queued again with a lower cost, the old entry is
+// skipped when it comes out since its cost doesn't match anymore.
+bool Cave::lowest_risk(uint32_t& risk) {
+    if (_width == 0 || _height == 0) return false;
+    const size_t n_chitons = (size_t) _width * _height;
+
+    free(_cost_for);
+    _cost_for = (uint32_t*) malloc(n_chitons * sizeof(uint32_t));
+    if (_cost_for == NULL) return false;
+    memset(_cost_for, 0xFF, n_chitons * sizeof(uint32_t));
+
+    // the front of the search is about a diagonal of the grid wide
+    if (!_to_visit.init(MAX_RISK, _width + _height)) return false;
+
+    const uint32_t goal = n_chitons - 1;
+    _cost_for[0] = 0;
+    bool ok = _to_visit.push(0, 0);
+
+    uint32_t pos, cost;
+    while (ok && _to_visit.pop(pos, cost)) {
+        if (cost != _cost_for[pos]) continue;
+        if (pos == goal) break;
+
+        const uint32_t x = pos % _width;
+        const uint32_t y = pos / _width;
+        if (x != 0) ok &= visit(pos - 1, cost);
+        if (y != 0) ok &= visit(pos - _width, cost);
+        if (x != _width - 1) ok &= visit(pos + 1, cost);
+        if (y != _height - 1) ok &= visit(pos + _width, cost);
     }
+    _to_visit.destroy();
 
-    //for (uint16_t i = 0 ; i < MAX_CHITONS; ++i)
-    //    printf("%u: %u\n", i, _cost_for[i]);
-
-    return _cost_for[hash(X_MAX - 1, Y_MAX - 1)];
+    risk = _cost_for[goal];
+    return ok && risk != UNVISITED;
 }
 
-bool Cave::add_row(const char* str) {
-    uint8_t it = 0;
-    while (str[it] != 0) {
-        if (it == X_MAX || _y == Y_MAX) return false;
-        _chitons[hash(it, _y)] = str[it] - '0';
-        ++it;
+// simple row of risks:
+// 1163751742
+// all rows must be as wide as the first one
+bool Cave::add_row(const LineView& line) {
+    if (_height == 0) _width = line.size;
+    if (line.size != _width || _width == 0) return false;
+
+    const size_t needed = (size_t) (_height + 1) * _width;
+    if (needed > _capacity) {
+        const size_t capacity = (_capacity == 0)? needed * 16 : _capacity * 2;
+        uint8_t* chitons = (uint8_t*) realloc(_chitons, capacity);
+        if (chitons == NULL) return false;
+        _chitons = chitons;
+        _capacity = capacity;
+    }
+
+    uint8_t* row = _chitons + (size_t) _height * _width;
+    for (uint32_t it = 0; it < _width; ++it) {
+        if (!ascii_isdigit(line.str[it]) || line.str[it] == '0') return false;
+        row[it] = line.str[it] - '0';
     }
-    ++_y;
+    ++_height;
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -139,21 +153,34 @@ int main(int argc, char **argv)
     cave.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!cave.add_row(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!cave.add_row(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
-    const uint16_t answer1 = cave.lowest_risk(X_MAX, Y_MAX);
-    const uint32_t answer2 = 0;
+    profile_end();
+    uint32_t answer1, answer2;
+    profile_begin("part1");
+    bool found = cave.lowest_risk(answer1);
+    profile_end();
+    profile_begin("part2");
+    found = found && cave.expand(EXPAND_TIMES) && cave.lowest_risk(answer2);
+    profile_end();
+    if (!found) {
+        printf("Couldn't find a path.\n");
+        return -1;
+    }
 
     file.close();
     cave.destroy();
@@ -162,7 +189,15 @@ int main(int argc, char **argv)
     printf("Day 15 completion time: %" PRIu64 "µs\n", completion_time);
 
     printf("Answer 1 = %u\n", answer1);
-    printf("Answer 1 = %u\n", answer2);
+    printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,265 +1,183 @@
-#include <bitset>
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
+#include "bitset.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint16_t INPUT_MAX = 2048;
-static const uint16_t MAX_BITS = 1366 * 4;
-static const uint8_t SUB_RESULTS_MAX = 64;
-
 typedef struct Transmission {
-    void init();
+    bool init();
     void destroy();
-    bool add_bits(const char* str);
-    uint64_t parse();
-    uint16_t version_sum() const { return _version_sum; }
+    bool add_bits(const LineView& line);
+    bool parse(uint64_t* result);
+    uint64_t version_sum() const { return _version_sum; }
     
 private:
     bool read_n(const uint8_t n, uint8_t* value);
     bool read_nn(const uint8_t nn, uint16_t* value);
-    uint8_t parse_litteral(uint64_t* value);
-    uint64_t parse_packet(uint64_t* result);
+    bool parse_litteral(uint64_t* value, uint32_t* read);
+    bool parse_packet(uint64_t* result, uint32_t* read);
 
-    // std::bitset is actually pretty fast
-    std::bitset<MAX_BITS> _bits;
-    uint16_t _it;
-    uint16_t _version_sum;
-    uint16_t _packet_size;
+    // the transmission is stored backwards, its first bit is the last one,
+    // so n bits read in one extract come out most significant bit first
+    Bitset _bits;
+    uint32_t _it;
+    uint64_t _version_sum;
+    uint32_t _packet_size;
 
 } Transmission;
 
-void Transmission::init() {
+bool Transmission::init() {
     _it = 0;
     _version_sum = 0;
     _packet_size = 0;
+    return _bits.init(0);
 }
 
 void Transmission::destroy() {
-    // nothing
+    _bits.destroy();
 }
 
 bool Transmission::read_n(const uint8_t n, uint8_t* value) {
-    if (_it + n - 1 >= _packet_size) return false;
-
-    *value = 0;
-    for (uint8_t i = n; i > 0; --i) {
-        *value <<= 1;
-        *value += _bits[_it];
-        _it += 1;
-    }
+    if (_it + n > _packet_size) return false;
+    _it += n;
+    *value = _bits.extract(_packet_size - _it, n);
     return true;
 }
 
 bool Transmission::read_nn(const uint8_t nn, uint16_t* value) {
-    if (_it + nn- 1 >= _packet_size) return false;
-
-    *value = 0;
-    for (uint8_t i = nn; i > 0; --i) {
-       *value <<= 1;
-       *value += _bits[_it];
-        _it += 1;
-    }
+    if (_it + nn > _packet_size) return false;
+    _it += nn;
+    *value = _bits.extract(_packet_size - _it, nn);
     return true;
 }
 
-uint8_t Transmission::parse_litteral(uint64_t* value) {
+bool Transmission::parse_litteral(uint64_t* value, uint32_t* read) {
     uint8_t more = 1;
-    uint8_t n_read = 0;
     *value = 0;
 
     while (more) {
-        read_n(1, &more);
-        *value <<= 4;
         uint8_t v = 0;
-        read_n(4, &v);
-        *value += v;
-        n_read += 5;
+        if (!read_n(1, &more) || !read_n(4, &v)) return false;
+        *value = (*value << 4) + v;
+        *read += 5;
+    }
+    return true;
+}
+
+// fold a sub packet value into its operator packet value
+static bool fold_value(const uint8_t packet_type, const uint32_t index, const uint64_t sub, uint64_t* value) {
+    switch (packet_type) {
+        case 0: *value += sub; break;
+        case 1: *value *= sub; break;
+        case 2: if (sub < *value) *value = sub; break;
+        case 3: if (sub > *value) *value = sub; break;
+        // comparisons keep the first value until the second comes
+        case 5:
+        case 6:
+        case 7:
+            if (index == 0) { *value = sub; break; }
+            if (index > 1) return false;
+            if (packet_type == 5) *value = (*value > sub)? 1 : 0;
+            else if (packet_type == 6) *value = (*value < sub)? 1 : 0;
+            else *value = (*value == sub)? 1 : 0;
+            break;
+        default: return false;
     }
-    return n_read;
+    return true;
 }
 
-uint64_t Transmission::parse_packet(uint64_t* result) {
+bool Transmission::parse_packet(uint64_t* result, uint32_t* read) {
     uint8_t version;
-    uint16_t read = 0;
-    uint64_t packet_value = 0;
-    if (!read_n(3, &version)) return read;
-    read += 3;
+    if (!read_n(3, &version)) return false;
+    *read += 3;
     _version_sum += version;
 
     uint8_t packet_type;
-    if (!read_n(3, &packet_type)) return read;
-    read += 3;
+    if (!read_n(3, &packet_type)) return false;
+    *read += 3;
 
     // bail out as soon as possible if we have a type 4
-    if (packet_type == 4) {
-        uint8_t n_read = parse_litteral(&packet_value);
-        read += n_read;
-        *result = packet_value;
-        return read;
-    }
+    if (packet_type == 4) return parse_litteral(result, read);
 
     // otherwise, we got an operator packet
-    // let's retrieve all the sub packets first
-
-    uint64_t sub_results[SUB_RESULTS_MAX];
-    uint8_t n_results = 0;
+    // each sub packet is folded into the value as soon as it is parsed
+    uint64_t packet_value = 0;
+    if (packet_type == 1) packet_value = 1;
+    else if (packet_type == 2) packet_value = UINT64_MAX;
+    uint32_t n_results = 0;
 
     uint8_t length_type_id;
-    if(!read_n(1, &length_type_id)) return read;
-    read += 1;
+    if (!read_n(1, &length_type_id)) return false;
+    *read += 1;
 
     if (length_type_id == 0) {
         // length type 0
         // 15 bits number indicates how many bits are in the sub packets
         uint16_t length;
-        if(!read_nn(15, &length)) return read;
-        read += 15;
+        if (!read_nn(15, &length)) return false;
+        *read += 15;
 
-        uint16_t total = 0;
+        uint32_t total = 0;
         while (total < length) {
-            total += parse_packet(&sub_results[n_results]);
-            if (n_results++ == SUB_RESULTS_MAX) return read;
+            uint64_t sub;
+            if (!parse_packet(&sub, &total)) return false;
+            if (!fold_value(packet_type, n_results++, sub, &packet_value)) return false;
         }
-        read += total;
-    } else { 
+        if (total != length) return false;
+        *read += total;
+    } else {
         // length type 1
         // 11 bits number indicates how many sub packets there are
         uint16_t length;
-        if(!read_nn(11, &length)) return read;
-        read += 11;
-        while (length > 0) {
-            read += parse_packet(&sub_results[n_results]);
-            if (n_results++ == SUB_RESULTS_MAX) return read;
-            length -= 1;
+        if (!read_nn(11, &length)) return false;
+        *read += 11;
+        for (; length > 0; --length) {
+            uint64_t sub;
+            if (!parse_packet(&sub, read)) return false;
+            if (!fold_value(packet_type, n_results++, sub, &packet_value)) return false;
         }
     }
 
-    // Now calculate the packet value according to the operator
-    switch (packet_type) {
-        case 0:
-            for (uint8_t i = 0; i < n_results; ++i)
-                packet_value += sub_results[i];
-            break;
-        case 1:
-            packet_value = 1;
-            for (uint8_t i = 0; i < n_results; ++i)
-                packet_value *= sub_results[i];
-            break;
-        case 2:
-            packet_value = UINT64_MAX;
-            for (uint8_t i = 0; i < n_results; ++i)
-                if (sub_results[i] < packet_value) packet_value = sub_results[i];
-            break;
-        case 3:
-            for (uint8_t i = 0; i < n_results; ++i)
-                if (sub_results[i] > packet_value) packet_value = sub_results[i];
-            break;
-        case 5:
-            if (n_results < 2) break;
-            packet_value = (sub_results[0] > sub_results[1])? 1 : 0;
-            break;
-        case 6:
-            if (n_results < 2) break;
-            packet_value = (sub_results[0] < sub_results[1])? 1 : 0;
-            break;
-        case 7:
-            if (n_results < 2) break;
-            packet_value = (sub_results[0] == sub_results[1])? 1 : 0;
-            break;
-        default: return 0;
-    }
+    // comparisons need both values
+    if (packet_type >= 5 && n_results != 2) return false;
 
     *result = packet_value;
-    return read;
+    return true;
 }
 
-uint64_t Transmission::parse() {
-    uint64_t result = 0;
-    parse_packet(&result);
-    return result;
+bool Transmission::parse(uint64_t* result) {
+    uint32_t read = 0;
+    return parse_packet(result, &read);
 }
 
-bool Transmission::add_bits(const char* str) {
-    uint16_t it = 0;
-    while (str[it] != 0) {
-        const uint16_t pos = it*4;
-        if (pos > MAX_BITS) return false;
-        switch (str[it]) {
-            case '0': break;
-            case '1':
-                _bits.set(pos + 3, 1);
-                break;
-            case '2':
-                _bits.set(pos + 2, 1);
-                break;
-            case '3':
-                _bits.set(pos + 3, 1);
-                _bits.set(pos + 2, 1);
-                break;
-            case '4':
-                _bits.set(pos + 1, 1);
-                break;
-            case '5':
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            case '6':
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 2, 1);
-                break;
-            case '7':
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 2, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            case '8':
-                _bits.set(pos, 1);
-                break;
-            case '9':
-                _bits.set(pos, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            case 'A':
-                _bits.set(pos, 1);
-                _bits.set(pos + 2, 1);
-                break;
-            case 'B':
-                _bits.set(pos, 1);
-                _bits.set(pos + 2, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            case 'C':
-                _bits.set(pos, 1);
-                _bits.set(pos + 1, 1);
-                break;
-            case 'D':
-                _bits.set(pos, 1);
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            case 'E':
-                _bits.set(pos, 1);
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 2, 1);
-                break;
-            case 'F':
-                _bits.set(pos, 1);
-                _bits.set(pos + 1, 1);
-                _bits.set(pos + 2, 1);
-                _bits.set(pos + 3, 1);
-                break;
-            default: return false;
+// a new line is a new transmission
+bool Transmission::add_bits(const LineView& line) {
+    const size_t size = line.size * 4;
+    _bits.destroy();
+    if (!_bits.init(size)) return false;
+
+    for (size_t it = 0; it < line.size; ++it) {
+        const char c = line.str[it];
+        uint8_t value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+        else return false;
+
+        // the 4 bits of the digit, backwards, its high bit is the lowest index
+        const size_t pos = size - 4 - it * 4;
+        for (uint8_t bit = 0; bit < 4; ++bit) {
+            if (BIT_CHECK(value, bit)) _bits.set(pos + bit);
         }
-        ++it;
     }
-    _packet_size = it*4;
+    _packet_size = size;
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -269,24 +187,37 @@ int main(int argc, char **argv)
     }
 
     Transmission transmission;
-    transmission.init();
+    if (!transmission.init()) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!transmission.add_bits(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!transmission.add_bits(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
-    const uint64_t answer2 = transmission.parse();
-    const uint16_t answer1 = transmission.version_sum();
+    profile_end();
+    profile_begin("solve");
+    uint64_t answer2 = 0;
+    if (!transmission.parse(&answer2)) {
+        printf("Error with input.\n");
+        return -1;
+    }
+    const uint64_t answer1 = transmission.version_sum();
+    profile_end();
 
     file.close();
     transmission.destroy();
@@ -294,8 +225,16 @@ int main(int argc, char **argv)
     const uint64_t completion_time = timer_stop();
     printf("Day 16 completion time: %" PRIu64 "µs\n", completion_time);
 
-    printf("Answer 1 = %u\n", answer1);
+    printf("Answer 1 = %lu\n", answer1);
     printf("Answer 2 = %lu\n", answer2);
+    report_answer("%lu", answer1);
+    report_answer("%lu", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,24 +1,25 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "bench.h"
 #include "file.h"
+#include "profile.h"
+#include "record.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint16_t INPUT_MAX = 64;
 static const uint8_t MAX_STEPS = 250;
 
 typedef struct Launcher {
     void init();
     void destroy();
-    bool set_area(const char* str);
+    bool set_area(const LineView& line);
     void calc();
 
     int16_t _highest_point;
     uint16_t _launch_count;
 
 private:
-    bool read_num(const char* str, const char stop, int16_t* out);
     bool in_range(const int16_t x, const int16_t y);
     bool launch(int16_t x_vel, int16_t y_vel, int16_t* out_highest);
 
@@ -26,7 +27,6 @@ private:
     int16_t _x_max;
     int16_t _y_min;
     int16_t _y_max;
-    uint8_t _it;
 } Launcher;
 
 void Launcher::init() {
@@ -98,35 +98,24 @@ void Launcher::calc() {
     }
 }
 
-bool Launcher::read_num(const char* str, const char limit, int16_t* out) {
-    bool is_negative = false;
-    int16_t value = 0;
-    while (str[_it] != 0 && str[_it] != limit) {
-        if (ascii_isdigit(str[_it])) {
-            const char c = str[_it] - '0';
-            value *= 10; // this can overflow
-            value += c;
-        } else if (str[_it] == '-') {
-            is_negative = true;
-        }
-        ++_it;
-    }
-    *out = (is_negative)? -value : value;
-    return true;
-}
-
 // target area: x=20..30, y=-10..-5
-bool Launcher::set_area(const char* str) {
-    _it = 0;
-    if (!read_num(str, '.', &_x_min)) return false;
-    if (!read_num(str, ',', &_x_max)) return false;
-    if (!read_num(str, '.', &_y_min)) return false;
-    if (!read_num(str, '\0', &_y_max)) return false;
+bool Launcher::set_area(const LineView& line) {
+    Record area;
+    area.compile("target area: x=%d..%d, y=%d..%d");
+    int32_t values[4];
+    if (!area.scan(line, values)) return false;
+    for (uint8_t i = 0; i < 4; ++i) {
+        if (values[i] < INT16_MIN || values[i] > INT16_MAX) return false;
+    }
 
+    _x_min = values[0];
+    _x_max = values[1];
+    _y_min = values[2];
+    _y_max = values[3];
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -139,20 +128,26 @@ int main(int argc, char **argv)
     launcher.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!launcher.set_area(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!launcher.set_area(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("solve");
     launcher.calc();
+    profile_end();
 
     const int16_t answer1 = launcher._highest_point;
     const uint16_t answer2 = launcher._launch_count;
@@ -165,6 +160,14 @@ int main(int argc, char **argv)
 
     printf("Answer 1 = %i\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%i", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
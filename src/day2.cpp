@@ -1,24 +1,22 @@
 #include <stdio.h>
 
-#include "file.h"
+#include "bench.h"
+#include "profile.h"
+#include "stream.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const size_t LINE_LENGTH = 12;
-
-static bool extract_digit(const char* str, int* out) {
+static bool extract_digit(const LineView& line, int* out) {
     size_t i = 0;
-    while (str[i] != ' ') {
-        if (str[i] == '\0') return false;
-        ++i;
-    }
-    if (!ascii_isdigit(str[++i])) return false;
+    while (i < line.size && line.str[i] != ' ') ++i;
+    if (i + 1 >= line.size) return false;
+    if (!ascii_isdigit(line.str[++i])) return false;
 
-    *out = str[i] - '0';
+    *out = line.str[i] - '0';
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -27,22 +25,25 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    File file;
-    if(file.open(argv[1]) == false) {
+    Stream stream;
+    profile_begin("read");
+    if(stream.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[LINE_LENGTH];
+    LineView line;
     int horizontal_pos = 0;
     int depth = 0;
     int depth2 = 0;
     int aim = 0;
-    while (file.readline(str, LINE_LENGTH)) {
+    profile_begin("parse");
+    while (stream.next_line(line)) {
         int val;
-        if (!extract_digit(str, &val)) continue;
+        if (!extract_digit(line, &val)) continue;
 
-        switch(str[0]) {
+        switch(line.str[0]) {
             case 'f': 
                 horizontal_pos += val;
                 depth2 += (aim * val);
@@ -58,16 +59,29 @@ int main(int argc, char **argv)
             default: continue;
         }
     }
+    profile_end();
+    if (stream.failed()) {
+        printf("Couldn't read file %s\n", argv[1]);
+        return -1;
+    }
 
     const int answer1 = horizontal_pos * depth;
     const int answer2 = horizontal_pos * depth2;
 
-    file.close();
+    stream.close();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 2 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %i\n", answer1);
     printf("Answer 2 = %i\n", answer2);
+    report_answer("%i", answer1);
+    report_answer("%i", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,21 +1,19 @@
-#include <bitset>
 #include <stdio.h>
 
+#include "bench.h"
+#include "cpu.h"
 #include "bitset.h"
 #include "file.h"
+#include "profile.h"
 #include "timer.h"
 
-const uint16_t INPUT_MAX = 513;
 const uint16_t ALGO_SIZE = 512;
+const uint8_t STEPS = 50;
 
-// We preallocate everything, so if you intend to step more, change this
-const uint16_t STEP_ADD = 2;
-const uint16_t MAX_STEP = 50;
-const uint16_t BASE_PICTURE_SIDE = 100;
-const uint16_t PADDING = 4 + (STEP_ADD * MAX_STEP);
-const uint16_t PICTURE_SIDE = BASE_PICTURE_SIDE + PADDING;
-const uint16_t PICTURE_SIZE = PICTURE_SIDE * PICTURE_SIDE;
-const uint16_t INPUT_START = PADDING / 2 + (PADDING / 2 * PICTURE_SIDE);
+// The picture is sized from the input: each step grows the image by a
+// pixel on every side, plus a frame that always holds the infinite value.
+// Rows are padded to whole words.
+const size_t FRAME = 2;
 
 // BETTER, Can we keep an array of all the 9-bit binary numbers
 // we have in picture instead of ALL pixels?
@@ -23,8 +21,9 @@ const uint16_t INPUT_START = PADDING / 2 + (PADDING / 2 * PICTURE_SIDE);
 typedef struct Enhancer {
     void init();
     void destroy();
-    bool read_algorithm(const char* str);
-    bool read_picture(const char* str);
+    bool read_algorithm(const LineView& line);
+    bool size_picture(const size_t width, const size_t height, const uint8_t steps);
+    bool read_picture(const LineView& line);
 
     void enhance_n(const uint8_t n);
     size_t pixels_on() const;
@@ -32,16 +31,21 @@ typedef struct Enhancer {
     size_t _answer_1;
 
 private:
-    uint16_t algo_index(const uint16_t input_i);
+    uint16_t algo_index(const size_t i) const;
 
-    std::bitset<PICTURE_SIZE> _picture;
-    std::bitset<PICTURE_SIZE> _buffer;
-    std::bitset<ALGO_SIZE> _algorithm;
+    Bitset _picture;
+    Bitset _buffer;
+    // the algorithm indexed by algo_index, see read_algorithm
+    Bitset _algorithm;
 
     uint16_t _algo_read;
-    uint16_t _picture_line;
+    size_t _picture_line;
 
-    uint32_t _picture_start;
+    size_t _width; // a row, padding included
+    size_t _height;
+    size_t _margin;
+    size_t _input_width;
+    size_t _input_height;
     uint8_t _infinite_value;
 
 } Enhancer;
@@ -49,108 +53,106 @@ private:
 void Enhancer::init() {
     _algo_read = 0;
     _picture_line = 0;
-    _picture_start = 0;
+    _width = 0;
+    _height = 0;
+    _margin = 0;
+    _input_width = 0;
+    _input_height = 0;
     _infinite_value = 0;
     _answer_1 = 0;
+    _picture.init(0);
+    _buffer.init(0);
+    _algorithm.init(ALGO_SIZE);
 }
 
 void Enhancer::destroy() {
-    // nothing
+    _picture.destroy();
+    _buffer.destroy();
+    _algorithm.destroy();
 }
 
 size_t Enhancer::pixels_on() const {
     return _picture.count();
 }
 
-bool Enhancer::read_picture(const char* str) {
-    uint8_t it = 0;
-    const uint16_t line_start = INPUT_START + _picture_line * PICTURE_SIDE;
-    while (str[it] != 0) {
-        if (str[it] == '#') {
-            if (line_start + it == PICTURE_SIZE) return false;
-            _picture.set(line_start + it, 1);
-        }
-        ++it;
+bool Enhancer::size_picture(const size_t width, const size_t height, const uint8_t steps) {
+    _margin = steps + FRAME;
+    _input_width = width;
+    _input_height = height;
+    _width = (width + 2 * _margin + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS * BITSET_WORD_BITS;
+    _height = height + 2 * _margin;
+    _picture.destroy();
+    _buffer.destroy();
+    const bool picture_ok = _picture.init(_width * _height);
+    const bool buffer_ok = _buffer.init(_width * _height);
+    return picture_ok && buffer_ok;
+}
+
+bool Enhancer::read_picture(const LineView& line) {
+    if (line.size > _input_width || _picture_line >= _input_height) return false;
+    const size_t line_start = (_margin + _picture_line) * _width + _margin;
+    for (size_t it = 0; it < line.size; ++it) {
+        if (line.str[it] == '#') _picture.set(line_start + it);
     }
     _picture_line += 1;
     return true;
 }
 
-bool Enhancer::read_algorithm(const char* str) {
-    uint16_t it = 0;
-    while (str[it] != 0) {
-        if (str[it] == '#') {
-            if (_algo_read + it == ALGO_SIZE) return false;
-            _algorithm.set(_algo_read + it, 1);
+// A 3x3 square reads as 9 bits from its top left pixel, in rows.
+// Our rows come out of the bitset from their left pixel as bit 0,
+// so the algorithm is stored with each index reversed on 9 bits.
+bool Enhancer::read_algorithm(const LineView& line) {
+    if (_algo_read + line.size > ALGO_SIZE) return false;
+    for (size_t it = 0; it < line.size; ++it) {
+        if (line.str[it] != '#') continue;
+        const uint16_t index = _algo_read + it;
+        uint16_t reversed = 0;
+        for (uint8_t bit = 0; bit < 9; ++bit) {
+            if (BIT_CHECK(index, bit)) BIT_SET(reversed, 8 - bit);
         }
-        ++it;
+        _algorithm.set(reversed);
     }
-    _algo_read += it;
+    _algo_read += line.size;
     return true;
 }
 
-static inline uint16_t picture_index(const uint16_t x, const uint16_t y) { 
-    return x + y * PICTURE_SIDE;
-}
-
 /*
     Each pixel of the output image is determined by looking at a 3x3 square
     of pixels centered on the corresponding input image pixel.
 
-    The picture is considered infinite, so anything not in our bounds is 0.
+    i is never on the frame, so the square is always in the picture.
 */
-uint16_t Enhancer::algo_index(const uint16_t input_i) {
-    uint16_t binary_index = 0;
-    const uint16_t x = input_i % PICTURE_SIDE;
-    const uint16_t y = input_i / PICTURE_SIDE;
-
-    const bool first_row = (y == 0);
-    const bool last_row = (y == (PICTURE_SIDE-1));
-    const bool first_column = (x == 0);
-    const bool last_column = (x == (PICTURE_SIDE-1));
-
-    // we could do a complicated loop ... or just unroll it, it's only 9 points
-
-    binary_index += (first_column || first_row)?  _infinite_value : _picture[picture_index(x - 1, y - 1)];
-    binary_index <<= 1;
-    binary_index += (first_row)? _infinite_value : _picture[picture_index(x, y - 1)];
-    binary_index <<= 1;
-    binary_index += (last_column || first_row)? _infinite_value : _picture[picture_index(x + 1, y - 1)];
-    binary_index <<= 1;
-
-    binary_index += (first_column)? _infinite_value : _picture[picture_index(x - 1, y)];
-    binary_index <<= 1;
-    binary_index += _picture[picture_index(x, y)];
-    binary_index <<= 1;
-    binary_index += (last_column)? _infinite_value : _picture[picture_index(x + 1, y)];
-    binary_index <<= 1;
-
-    binary_index += (first_column || last_row)? _infinite_value : _picture[picture_index(x - 1, y + 1)];
-    binary_index <<= 1;
-    binary_index += (last_row)? _infinite_value : _picture[picture_index(x, y + 1)];
-    binary_index <<= 1;
-    binary_index += (last_column || last_row)? _infinite_value : _picture[picture_index(x + 1, y + 1)];
-
-    return binary_index;
+uint16_t Enhancer::algo_index(const size_t i) const {
+    const size_t left = i - 1;
+    return _picture.extract(left - _width, 3)
+         | (_picture.extract(left, 3) << 3)
+         | (_picture.extract(left + _width, 3) << 6);
 }
 
-void Enhancer::enhance_n(const uint8_t n) {
+CPU_CLONES void Enhancer::enhance_n(const uint8_t n) {
     _infinite_value = 0;
     // BETTER, don't scan everything before having extended into it
     for (uint8_t step = 0; step < n; ++step) {
-        for (uint16_t i = 0; i < PICTURE_SIZE; ++i) {
-            _buffer[i] = _algorithm[algo_index(i)];
-        }
-        std::swap(_buffer, _picture);
+        // the infinite picture all around goes through the algorithm too
+        const uint8_t infinite_value = _algorithm.get(_infinite_value? ALGO_SIZE - 1 : 0);
         _buffer.reset();
-        _infinite_value = !_infinite_value;
+        if (infinite_value) _buffer.fill();
+
+        for (size_t y = 1; y + 1 < _height; ++y) {
+            const size_t row = y * _width;
+            for (size_t x = 1; x + 1 < _width; ++x) {
+                _buffer.assign(row + x, _algorithm.get(algo_index(row + x)));
+            }
+        }
+        _picture.swap(_buffer);
+        _infinite_value = infinite_value;
 
         // save this answer for part 1
         if (step == 1) _answer_1 = pixels_on();
     }
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -163,26 +165,41 @@ int main(int argc, char **argv)
     enhancer.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
-
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 1) {
-        if (!enhancer.read_algorithm(str)) {
+    profile_end();
+
+    profile_begin("parse");
+    const size_t n_lines = file.count_lines();
+    size_t n_read = 1; // the empty line after the algorithm
+    LineView line;
+    while (file.next_line(line) && line.size > 0) {
+        if (!enhancer.read_algorithm(line)) {
             printf("Error with input.\n");
             return -1;
         }
+        ++n_read;
     }
-    while (file.readline(str, INPUT_MAX)) {
-        if (!enhancer.read_picture(str)) {
+    while (file.next_line(line)) {
+        if (line.size == 0) continue;
+        if (n_read < n_lines && !enhancer.size_picture(line.size, n_lines - n_read, STEPS)) {
+            printf("Couldn't allocate the picture.\n");
+            return -1;
+        }
+        n_read = n_lines;
+        if (!enhancer.read_picture(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
-    enhancer.enhance_n(50);
+    profile_end();
+    profile_begin("solve");
+    enhancer.enhance_n(STEPS);
+    profile_end();
 
     const size_t answer1 = enhancer._answer_1;
     const size_t answer2 = enhancer.pixels_on();
@@ -195,6 +212,14 @@ int main(int argc, char **argv)
 
     printf("Answer 1 = %zu\n", answer1);
     printf("Answer 2 = %zu\n", answer2);
+    report_answer("%zu", answer1);
+    report_answer("%zu", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
+#include "cpu.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-const uint16_t INPUT_MAX = 64;
 const uint8_t DICE_MAX = 100;
 const uint16_t WINNING_SCORE = 1000;
 const uint8_t N_ROLLS = 3;
@@ -38,7 +40,7 @@ const T& min(const T& a, const T& b)
 typedef struct Board {
     void init();
     void destroy();
-    bool read_state(const char* str);
+    bool read_state(const LineView& line);
 
     uint32_t answer1() const { return _answer1; }
     uint64_t answer2() const { return _answer2; }
@@ -68,7 +70,7 @@ void Board::destroy() {
 
 // BETTER, I feel there's a way to avoid so much copying
 // or using cache better while iterating this giant multi array
-void Board::play_dirac() {
+CPU_CLONES void Board::play_dirac() {
     // Count of actual game(s) at a specific game state for all combinaisons of:
     // P1 score, P1 position, P2 score, P2 position.
     typedef uint64_t GameState[DIRAC_WINNING+1][BOARD_LIMIT][DIRAC_WINNING+1][BOARD_LIMIT];
@@ -186,23 +188,19 @@ void Board::play() {
     }
 }
 
-bool Board::read_state(const char* str) {
-    uint8_t it = 0;
-    while (str[it] != 0) {
+bool Board::read_state(const LineView& line) {
+    const char* str = line.str;
+    size_t it = 0;
+    while (it < line.size) {
         if (str[it] == ':') break;
         it += 1;
     }
-    if (str[it] != ':') return false;
-    it += 2; // FIXME, unsafe
-
-    uint8_t value = 0;
-    while (str[it] != '\0') {
-        if (ascii_isdigit(str[it])) {
-            value *= 10;
-            value += str[it] - '0';
-        }
-        ++it;
-    }
+    if (it == line.size) return false;
+    it += 2; // skip ": "
+
+    const char* cursor = str + it;
+    uint32_t value;
+    if (parse_uint32(cursor, str + line.size, value) != INT_OK || value > UINT8_MAX) return false;
 
     for (uint8_t i = 0; i < N_PLAYERS; ++i) {
         if (_starting_pos[i] == 0) {
@@ -213,7 +211,7 @@ bool Board::read_state(const char* str) {
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -226,21 +224,29 @@ int main(int argc, char **argv)
     board.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 1) {
-        if (!board.read_state(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line) && line.size > 0) {
+        if (!board.read_state(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("part1");
     board.play();
+    profile_end();
+    profile_begin("part2");
     board.play_dirac();
+    profile_end();
 
     const uint32_t answer1 = board.answer1();
     const uint64_t answer2 = board.answer2();
@@ -253,6 +259,14 @@ int main(int argc, char **argv)
 
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %lu\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%lu", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -2,13 +2,16 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
+#include "cache.h"
 #include "file.h"
+#include "parallel.h"
+#include "profile.h"
+#include "record.h"
 #include "strtoint.h"
 #include "timer.h"
 
-const uint16_t INPUT_MAX = 128;
-const uint16_t MAX_PROCEDURES = 420;
-const uint16_t MAX_CUBES = 4000; // big enough for my input
+const uint32_t CACHE_VERSION = 1; // bump when Procedure changes
 
 typedef struct Cube {
     int32_t x1, x2;
@@ -35,20 +38,30 @@ typedef struct Procedure {
 typedef struct Reactor {
     void init();
     void destroy();
-    bool read_procedures(const char* str);
+    bool set_procedures(const size_t n);
+    bool read_procedure(const LineView& line, const size_t index);
+    bool load(const Cache& cache);
+    bool save(const char* input) const;
     uint32_t part_one() const { return _part_1; }
     uint64_t part_two() const { return _part_2; }
-    void reboot();
+    bool reboot();
 
 private:
     void add_diff(const Cube& c1, const Cube& c2);
-    Procedure _procedures[MAX_PROCEDURES];
-    uint16_t _n_procedure;
-
-    Cube _cubes[MAX_CUBES];
-    Cube _cubes_buffer[MAX_CUBES];
-    uint16_t _n_cubes = 0;
-    uint16_t _n_buffer = 0;
+    bool reserve_cubes(const size_t capacity);
+    // the parsed procedures, or the cache map when loaded from it
+    const Procedure* _procedures;
+    Procedure* _parsed;
+    Record _on;
+    Record _off;
+    size_t _n_procedure;
+
+    // both the same capacity, the buffer becomes the cubes each step
+    Cube* _cubes;
+    Cube* _cubes_buffer;
+    size_t _n_cubes;
+    size_t _n_buffer;
+    size_t _cubes_capacity;
 
     uint32_t _part_1;
     uint64_t _part_2;
@@ -56,15 +69,38 @@ private:
 } Reactor;
 
 void Reactor::init() {
+    _procedures = NULL;
+    _parsed = NULL;
     _n_procedure = 0;
+    _cubes = NULL;
+    _cubes_buffer = NULL;
     _n_cubes = 0;
     _n_buffer = 0;
+    _cubes_capacity = 0;
     _part_1 = 0;
     _part_2 = 0;
+    _on.compile("on x=%d..%d,y=%d..%d,z=%d..%d");
+    _off.compile("off x=%d..%d,y=%d..%d,z=%d..%d");
 }
 
 void Reactor::destroy() {
-    // nothing
+    free(_parsed);
+    free(_cubes);
+    free(_cubes_buffer);
+}
+
+bool Reactor::reserve_cubes(const size_t capacity) {
+    if (capacity <= _cubes_capacity) return true;
+    size_t new_capacity = (_cubes_capacity == 0)? 1024 : _cubes_capacity;
+    while (new_capacity < capacity) new_capacity *= 2;
+    Cube* cubes = (Cube*) realloc(_cubes, new_capacity * sizeof(Cube));
+    if (cubes == NULL) return false;
+    _cubes = cubes;
+    Cube* buffer = (Cube*) realloc(_cubes_buffer, new_capacity * sizeof(Cube));
+    if (buffer == NULL) return false;
+    _cubes_buffer = buffer;
+    _cubes_capacity = new_capacity;
+    return true;
 }
 
 template<class T> 
@@ -148,9 +184,12 @@ void Reactor::add_diff(const Cube& c1, const Cube& c2) {
 
 // Here, rather than keeping the whole universe, we just track
 // the intented cubes to be turned on using basic 3D collisions
-// FIXME, make the cube/buffer arrays safe to increment
-void Reactor::reboot() {
-    for (uint16_t i = 0; i < _n_procedure; ++i) {
+// false if we ran out of memory
+bool Reactor::reboot() {
+    for (size_t i = 0; i < _n_procedure; ++i) {
+        // a cube splits in 6 at most, plus the new one
+        if (!reserve_cubes(_n_cubes * 6 + 1)) return false;
+
         // create the cube for that procedure
         Cube cube;
         cube.x1 = _procedures[i].x[0];
@@ -160,7 +199,7 @@ void Reactor::reboot() {
         cube.z1 = _procedures[i].z[0];
         cube.z2 = _procedures[i].z[1];
         // compare against all our existing cubes
-        for (uint16_t j = 0; j < _n_cubes; ++j) {
+        for (size_t j = 0; j < _n_cubes; ++j) {
             // if we have a collision, only add the new parts
             if (_cubes[j].collision(cube)) add_diff(_cubes[j], cube);
             else {
@@ -173,15 +212,16 @@ void Reactor::reboot() {
             _cubes_buffer[_n_buffer] = cube;
             _n_buffer += 1;
         }
-        if (_n_buffer == 0) continue;
-        // swap with our buffer
-        memcpy(_cubes, _cubes_buffer, sizeof(Cube)*_n_buffer);
+        // swap with our buffer, an off that covers everything leaves none
+        Cube* cubes = _cubes;
+        _cubes = _cubes_buffer;
+        _cubes_buffer = cubes;
         _n_cubes = _n_buffer;
         _n_buffer = 0;
     }
 
     // now count the dots
-    for (uint16_t i = 0; i < _n_cubes; ++i) {
+    for (size_t i = 0; i < _n_cubes; ++i) {
         const uint64_t size = _cubes[i].size();
         // part one only considers cubes in the [-50,50] region.
         // technically we should check all coordinates but I take
@@ -190,76 +230,99 @@ void Reactor::reboot() {
         if (abs(_cubes[i].x1) <= 50) _part_1 += size;
         _part_2 += size;
     }
+    return true;
 }
 
-static uint32_t get_int(const char* str, uint8_t& it) {
-    int negative = 0;
-    int32_t ret = 0;
-
-    if (str[it] == '-') {
-        negative = 1;
-        it += 1;
-    } else if (str[it] == '+') {
-        it += 1;
-    }
+bool Reactor::set_procedures(const size_t n) {
+    Procedure* procedures = (Procedure*) realloc(_parsed, (n > 0? n : 1) * sizeof(Procedure));
+    if (procedures == NULL) return false;
+    // the padding after on is written to the cache too
+    memset(procedures, 0, n * sizeof(Procedure));
+    _parsed = procedures;
+    _procedures = procedures;
+    _n_procedure = n;
+    return true;
+}
 
-    while (str[it] != 0) {
-        if (ascii_isdigit(str[it])) {
-            ret *= 10; // this can overflow
-            ret += (str[it] - '0');
-        } else break;
-        it += 1;
-    }
+// Procedures are applied in order but parsed in any order,
+// each line has its own slot so threads never share one.
+// We expect a line in the form of:
+// on x=-20..26,y=-36..17,z=-47..7
+bool Reactor::read_procedure(const LineView& line, const size_t index) {
+    // past the procedures, ignored
+    if (index >= _n_procedure) return true;
+    Procedure& procedure = _parsed[index];
+
+    procedure.on = (line.size > 1 && line.str[1] == 'n');
+    int32_t values[6];
+    if (!(procedure.on? _on : _off).scan(line, values)) return false;
+
+    procedure.x[0] = values[0];
+    procedure.x[1] = values[1];
+    procedure.y[0] = values[2];
+    procedure.y[1] = values[3];
+    procedure.z[0] = values[4];
+    procedure.z[1] = values[5];
+    return true;
+}
 
-    if (negative) ret = -ret;
-    return ret;
+// cached as the number of procedures followed by all of them,
+// used in place so the cache must stay open until the reboot is done
+bool Reactor::load(const Cache& cache) {
+    uint64_t n;
+    if (cache.size() < sizeof(n)) return false;
+    memcpy(&n, cache.data(), sizeof(n));
+    if (n > (cache.size() - sizeof(n)) / sizeof(Procedure)) return false;
+    if (cache.size() != sizeof(n) + n * sizeof(Procedure)) return false;
+    const char* procedures = cache.data() + sizeof(n);
+    if ((uintptr_t) procedures % alignof(Procedure) != 0) return false;
+    _procedures = (const Procedure*) procedures;
+    _n_procedure = n;
+    return true;
 }
 
-bool Reactor::read_procedures(const char* str) {
-    if (_n_procedure == MAX_PROCEDURES) return false;
+bool Reactor::save(const char* input) const {
+    const uint64_t n = _n_procedure;
+    const CacheSection sections[2] = {
+        { &n, sizeof(n) },
+        { _procedures, n * sizeof(Procedure) },
+    };
+    return cache_save(input, CACHE_VERSION, sections, 2);
+}
 
-    // check on/off
-    if (str[0] != 'o') return false;
-    if (str[1] == 'n') _procedures[_n_procedure].on = true;
-    else if (str[1] == 'f') _procedures[_n_procedure].on = false;
-    else return false;
+static bool parse_procedure(const LineView& line, const size_t index, void* local, void* user) {
+    (void) local;
+    return ((Reactor*) user)->read_procedure(line, index);
+}
 
-    // skip to x
-    uint8_t it = 2;
-    while (str[it] != 0) {
-        if (str[it] == 'x') break;
-        it += 1;
-    }
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].x[0] = get_int(str, it);
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].x[1] = get_int(str, it);
-
-    // skip to y
-    while (str[it] != 0) {
-        if (str[it] == 'y') break;
-        it += 1;
+static bool read_input(const char* path, Reactor& reactor) {
+    File file;
+    if(file.open(path) == false) {
+        printf("Couldn't read file %s\n", path);
+        return false;
     }
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].y[0] = get_int(str, it);
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].y[1] = get_int(str, it);
-
-    // skip to z
-    while (str[it] != 0) {
-        if (str[it] == 'z') break;
-        it += 1;
+
+    Lines lines;
+    if (!lines.init(file)) {
+        printf("Couldn't index file %s\n", path);
+        file.close();
+        return false;
     }
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].z[0] = get_int(str, it);
-    it += 2; // FIXME, unsafe
-    _procedures[_n_procedure].z[1] = get_int(str, it);
 
-    _n_procedure += 1;
-    return true;
+    // procedures end at the first empty line
+    size_t n_lines = 0;
+    while (n_lines < lines.count() && lines.line(n_lines).size > 0) ++n_lines;
+
+    const bool ok = reactor.set_procedures(n_lines) &&
+                    parse_lines(lines, parse_threads(lines), parse_procedure, NULL, 0, &reactor);
+    if (!ok) printf("Error with input.\n");
+
+    lines.destroy();
+    file.close();
+    return ok;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -271,25 +334,36 @@ int main(int argc, char **argv)
     Reactor reactor;
     reactor.init();
 
-    File file;
-    if(file.open(argv[1]) == false) {
-        printf("Couldn't read file %s\n", argv[1]);
-        return -1;
-    }
-
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 1) {
-        if (!reactor.read_procedures(str)) {
-            printf("Error with input.\n");
-            return -1;
+    profile_begin("load");
+    const bool use_cache = cache_enabled();
+    Cache cache;
+    bool loaded = false;
+    if (use_cache && cache.open(argv[1], CACHE_VERSION)) {
+        loaded = reactor.load(cache);
+        // a sidecar that doesn't fit is parsed again and replaced
+        if (!loaded) {
+            cache.close();
+            printf("Ignoring the cache of %s\n", argv[1]);
         }
     }
+    if (!loaded) {
+        if (!read_input(argv[1], reactor)) return -1;
+        if (use_cache) reactor.save(argv[1]);
+    }
 
-    reactor.reboot();
+    profile_end();
+    profile_begin("solve");
+    const bool rebooted = reactor.reboot();
+    // the loaded procedures are in the map until here
+    if (loaded) cache.close();
+    if (!rebooted) {
+        printf("Couldn't allocate the cubes.\n");
+        return -1;
+    }
     const uint32_t answer1 = reactor.part_one();
     const uint64_t answer2 = reactor.part_two();
+    profile_end();
 
-    file.close();
     reactor.destroy();
 
     const uint64_t completion_time = timer_stop();
@@ -297,6 +371,14 @@ int main(int argc, char **argv)
 
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %lu\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%lu", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -2,8 +2,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "bench.h"
 #include "bitset.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
@@ -12,7 +14,6 @@
 //#error "no __uint128_t"
 //#endif
 
-const uint16_t INPUT_MAX = 256;
 const uint8_t MAX_X = 139;
 const uint8_t MAX_Y = 136;
 const uint16_t MAX_CUCUMBERS = 4800;
@@ -32,7 +33,7 @@ typedef struct Pos {
 typedef struct Cucumbers {
     void init();
     void destroy();
-    bool read_map(const char* str);
+    bool read_map(const LineView& line);
     uint16_t move();
     void print() const;
 
@@ -136,20 +137,16 @@ uint16_t Cucumbers::move() {
     return step;
 }
 
-bool Cucumbers::read_map(const char* str) {
-    size_t it = 0;
-    uint8_t i = 0;
-    while (str[it] != 0) {
-        //printf("%c",str[it]);
-        if (str[it] != '.') set(i, _row, (str[it] == 'v')? 3 : 1);
-        ++it;
-        ++i;
+bool Cucumbers::read_map(const LineView& line) {
+    for (size_t it = 0; it < line.size; ++it) {
+        //printf("%c",line.str[it]);
+        if (line.str[it] != '.') set(it, _row, (line.str[it] == 'v')? 3 : 1);
     }
     _row += 1;
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -162,20 +159,26 @@ int main(int argc, char **argv)
     cucumbers.init();
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX) > 1) {
-        if (!cucumbers.read_map(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line) && line.size > 0) {
+        if (!cucumbers.read_map(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
+    profile_end();
     printf("\n");
+    profile_begin("part1");
     const uint16_t answer1 = cucumbers.move();
+    profile_end();
 
     file.close();
     cucumbers.destroy();
@@ -184,6 +187,13 @@ int main(int argc, char **argv)
     printf("Day 25 completion time: %" PRIu64 "µs\n", completion_time);
 
     printf("Answer 1 = %u\n", answer1);
+    report_answer("%u", answer1);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
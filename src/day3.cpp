@@ -1,30 +1,31 @@
-#include <bitset>
 #include <limits.h>
 #include <stdio.h>
 
+#include "bench.h"
+#include "bitset.h"
 #include "file.h"
+#include "profile.h"
 #include "timer.h"
 
-static const size_t LINE_LENGTH = 13;
-static const size_t INPUT_LENGTH = LINE_LENGTH-1;
-static const int REPORT_MAX_LENGTH = 1000;
+// both ratings multiplied must fit in the answer
+static const size_t INPUT_LENGTH_MAX = 32;
 
-typedef std::bitset<REPORT_MAX_LENGTH> diagnostic_bitset;
+// one bitset per column, one bit per line of the report,
+// as many columns as the first line is wide
 
-static int most_at_bit(const diagnostic_bitset& line, const size_t n_lines) {
-    const size_t n_set = line.count();
+static int most_at_bit(const size_t n_set, const size_t n_lines) {
     if (n_set * 2 >= n_lines) return 1;
     return 0;
 }
 
-static uint power_consumption(const diagnostic_bitset* input) {
-    uint gamma = 0;
-    uint epsilon = 0;
-    for (size_t i = 0; i < INPUT_LENGTH; ++i) {
-        const int most = most_at_bit(input[i], REPORT_MAX_LENGTH);
+static uint64_t power_consumption(const Bitset* input, const size_t width, const size_t n_lines) {
+    uint64_t gamma = 0;
+    uint64_t epsilon = 0;
+    for (size_t i = 0; i < width; ++i) {
+        const int most = most_at_bit(input[i].count(), n_lines);
         if (most) gamma += 1;
         else epsilon += 1;
-        if (i + 1 < INPUT_LENGTH) {
+        if (i + 1 < width) {
             gamma <<= 1;
             epsilon <<= 1;
         }
@@ -32,50 +33,46 @@ static uint power_consumption(const diagnostic_bitset* input) {
     return gamma * epsilon;
 }
 
-static uint calc_rating(const diagnostic_bitset* input, const int pivot_value = 1) {
-    diagnostic_bitset mask_remaining;
-    diagnostic_bitset bits_line;
-    diagnostic_bitset xor_mask;
-
+// mask_remaining is scratch, the same size as the columns
+static uint64_t calc_rating(const Bitset* input, const size_t width, const size_t n_lines,
+                            Bitset& mask_remaining, const int pivot_value = 1) {
     // we start with all lines
-    mask_remaining.set();
-    for (size_t i = 0; i < INPUT_LENGTH; ++i) {
+    mask_remaining.reset();
+    mask_remaining.set_range(0, n_lines);
+    size_t n_remaining = n_lines;
+    for (size_t i = 0; i < width; ++i) {
         // calc the most common bit for position i
-        bits_line = input[i] & mask_remaining;
-        const int most = most_at_bit(bits_line, mask_remaining.count());
+        const int most = most_at_bit(input[i].count_and(mask_remaining), n_remaining);
 
         // filter out lines not matching the most common bit at position i
-        if (most == pivot_value) xor_mask.set();
-        else xor_mask.reset();
-        xor_mask ^= input[i];
-        mask_remaining &= xor_mask;
+        if (most == pivot_value) mask_remaining.and_with(input[i]);
+        else mask_remaining.andnot_with(input[i]);
 
-        if (mask_remaining.count() <= 1) break;
+        n_remaining = mask_remaining.count();
+        if (n_remaining <= 1) break;
     }
 
     // find the column index where our answer reside
-    size_t column_id = 0;
-    while (column_id < REPORT_MAX_LENGTH) {
-        if (mask_remaining.test(column_id)) break;
-        ++column_id;
-    }
+    const size_t column_id = mask_remaining.find_first();
+    if (column_id == mask_remaining.size()) return 0;
 
     // binary to decimal
-    uint result = 0;
-    for (size_t i = 0; i < INPUT_LENGTH; ++i) {
-        if (input[i][column_id]) result += 1;
-        if (i + 1 < INPUT_LENGTH) result <<= 1;
+    uint64_t result = 0;
+    for (size_t i = 0; i < width; ++i) {
+        if (input[i].get(column_id)) result += 1;
+        if (i + 1 < width) result <<= 1;
     }
     return result;
 }
 
-static uint life_support_rating(const diagnostic_bitset* input) {
-    const uint oxygen_rating = calc_rating(input);
-    const uint scrubber_rating = calc_rating(input, 0);
+static uint64_t life_support_rating(const Bitset* input, const size_t width, const size_t n_lines,
+                                    Bitset& scratch) {
+    const uint64_t oxygen_rating = calc_rating(input, width, n_lines, scratch);
+    const uint64_t scrubber_rating = calc_rating(input, width, n_lines, scratch, 0);
     return oxygen_rating * scrubber_rating;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -85,30 +82,83 @@ int main(int argc, char **argv)
     }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
+
+    profile_begin("parse");
+    // the first line gives the width, every line after must match it
+    const size_t max_lines = file.count_lines();
+    LineView line;
+    bool has_line = file.next_line(line);
+    while (has_line && line.size == 0) has_line = file.next_line(line);
+    const size_t width = has_line? line.size : 0;
+    if (width == 0 || width > INPUT_LENGTH_MAX) {
+        printf("Lines must be 1 to %zu bits wide.\n", INPUT_LENGTH_MAX);
+        return -1;
+    }
 
-    diagnostic_bitset input[INPUT_LENGTH];
-    char str[LINE_LENGTH];
-    int n_line = 0;
-    while (file.readline(str, LINE_LENGTH)) {
-        for (size_t i = 0; i < INPUT_LENGTH; ++i) {
-            if (str[i] == '1') input[i].set(n_line);
+    Bitset input[INPUT_LENGTH_MAX];
+    Bitset scratch;
+    size_t n_init = 0;
+    while (n_init < width && input[n_init].init(max_lines)) ++n_init;
+    if (n_init < width || !scratch.init(max_lines)) {
+        printf("Couldn't allocate for %zu lines.\n", max_lines);
+        for (size_t i = 0; i < n_init; ++i) input[i].destroy();
+        return -1;
+    }
+
+    size_t n_line = 0;
+    bool ok = true;
+    for (; has_line; has_line = file.next_line(line)) {
+        if (line.size == 0) continue;
+        if (line.size != width) {
+            ok = false;
+            break;
+        }
+        for (size_t i = 0; i < width; ++i) {
+            if (line.str[i] == '1') input[i].set(n_line);
+            else if (line.str[i] != '0') ok = false;
         }
         ++n_line;
     }
 
-    const uint answer1 = power_consumption(input);
-    const uint answer2 = life_support_rating(input);
+    profile_end();
+    uint64_t answer1 = 0;
+    uint64_t answer2 = 0;
+    if (ok) {
+        profile_begin("part1");
+        answer1 = power_consumption(input, width, n_line);
+        profile_end();
+        profile_begin("part2");
+        answer2 = life_support_rating(input, width, n_line, scratch);
+        profile_end();
+    }
 
+    for (size_t i = 0; i < width; ++i) input[i].destroy();
+    scratch.destroy();
     file.close();
 
+    if (!ok) {
+        printf("Error with input, all lines must be %zu bits wide.\n", width);
+        return -1;
+    }
+
     const uint64_t completion_time = timer_stop();
     printf("Day 3 completion time: %" PRIu64 "µs\n", completion_time);
-    printf("Answer 1 = %u\n", answer1);
-    printf("Answer 2 = %u\n", answer2);
+    printf("Answer 1 = %lu\n", answer1);
+    printf("Answer 2 = %lu\n", answer2);
+    report_answer("%lu", answer1);
+    report_answer("%lu", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,6 +1,11 @@
 #include <stdio.h>
+#include <string.h>
 
+#include "bench.h"
+#include "cache.h"
+#include "csv.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
@@ -8,7 +13,7 @@ static const size_t MAX_BOARDS = 128;
 static const size_t BOARD_SIDE = 5;
 static const size_t BOARD_SIZE = BOARD_SIDE * BOARD_SIDE;
 static const size_t MAX_DRAWS = 128;
-static const size_t INPUT_MAX = 512;
+static const uint32_t CACHE_VERSION = 1; // bump when Board changes
 
 static const unsigned char DRAWN_VALUE = 0xFF;
 
@@ -26,7 +31,10 @@ typedef struct Boards {
     void destroy();
     uint unmarked_sum(const size_t board_id);
     int mark(const unsigned char value, Winner& winner, const bool checkbingo);
-    void add_row(const char* str);
+    bool add_row(const LineView& line);
+    bool load(const Board* boards, const size_t n);
+    const Board* boards() const { return _boards; }
+    size_t count() const { return _n_boards; }
     bool bingo_all_boards(unsigned char* draws, const size_t draw_size, uint* first_score, uint* last_score);
 
 private:
@@ -47,31 +55,28 @@ void Boards::increase_cell() {
     }
 }
 
-void Boards::add_row(const char* str) {
-    size_t it = 0;
-    unsigned char value = 0;
-    char last_char = 0;
-    while (str[it] != '\0') {
-        if (str[it] == ' ') {
-            last_char = ' ';
-            ++it;
-            continue;
-        }
-        if (last_char == ' ' && it > 1) {
-            _boards[_n_boards][_current_cell] = value;
-            increase_cell();
-            value = 0;
-        }
-        if (ascii_isdigit(str[it])) {
-            const char c = str[it] - '0';
-            value *= 10;
-            value += c;
-        }
-        last_char = str[it];
-        ++it;
+// numbers are right aligned with spaces
+bool Boards::add_row(const LineView& line) {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    while (true) {
+        while (it < end && *it == ' ') ++it;
+        if (it == end) return true;
+
+        uint32_t value;
+        // can't collide with the drawn flag
+        if (parse_uint32(it, end, value) != INT_OK || value >= DRAWN_VALUE) return false;
+        _boards[_n_boards][_current_cell] = value;
+        increase_cell();
     }
-    _boards[_n_boards][_current_cell] = value;
-    increase_cell();
+}
+
+bool Boards::load(const Board* boards, const size_t n) {
+    if (n > MAX_BOARDS) return false;
+    memcpy(_boards, boards, n * sizeof(Board));
+    _n_boards = n;
+    _current_cell = 0;
+    return true;
 }
 
 void Boards::destroy() {
@@ -177,31 +182,73 @@ bool Boards::bingo_all_boards(unsigned char* draws, const size_t draw_size, uint
     return true;
 }
 
-static size_t parse_draws(const char* str, unsigned char* draws, const size_t draw_size) {
-    size_t it = 0;
-    size_t draw_i = 0;
-    unsigned char draw = 0;
-    while (str[it] != '\0') {
-        if (str[it] == ',') {
-            draws[draw_i] = draw;
-            if (draw_i >= draw_size) return 0;
-            ++draw_i;
-            ++it;
-            draw = 0;
-        }
+// return the number of draws, 0 on error
+static size_t parse_draws(const LineView& line, unsigned char* draws, const size_t draw_size) {
+    const char* it = line.str;
+    size_t count;
+    if (decode_csv(it, line.str + line.size, draws, draw_size, count) != CSV_OK) return 0;
+    // can't collide with the drawn flag
+    for (size_t i = 0; i < count; ++i) {
+        if (draws[i] == DRAWN_VALUE) return 0;
+    }
+    return count;
+}
+
+// cached as the draw and board counts followed by the draws and boards
+static bool load_cache(const Cache& cache, Boards& boards, unsigned char* draws, size_t& draw_size) {
+    uint64_t n[2];
+    if (cache.size() < sizeof(n)) return false;
+    memcpy(n, cache.data(), sizeof(n));
+    if (n[0] > MAX_DRAWS || n[1] > MAX_BOARDS) return false;
+    if (cache.size() != sizeof(n) + n[0] + n[1] * sizeof(Board)) return false;
+
+    memcpy(draws, cache.data() + sizeof(n), n[0]);
+    draw_size = n[0];
+    return boards.load((const Board*) (cache.data() + sizeof(n) + n[0]), n[1]);
+}
+
+static bool save_cache(const char* input, const Boards& boards, const unsigned char* draws, const size_t draw_size) {
+    const uint64_t n[2] = { draw_size, boards.count() };
+    const CacheSection sections[3] = {
+        { n, sizeof(n) },
+        { draws, draw_size },
+        { boards.boards(), boards.count() * sizeof(Board) },
+    };
+    return cache_save(input, CACHE_VERSION, sections, 3);
+}
+
+static bool read_input(const char* path, Boards& boards, unsigned char* draws, size_t& draw_size) {
+    File file;
+    if(file.open(path) == false) {
+        printf("Couldn't read file %s\n", path);
+        return false;
+    }
 
-        if (ascii_isdigit(str[it])) {
-            const char c = str[it] - '0';
-            draw *= 10;
-            draw += c;
+    LineView line;
+    int n_line = 0;
+    while (file.next_line(line)) {
+        if (n_line > 1 && line.size > 0) {
+            if (!boards.add_row(line)) {
+                printf("Error with input.\n");
+                file.close();
+                return false;
+            }
+        } else if (n_line == 0) {
+            draw_size = parse_draws(line, draws, MAX_DRAWS);
+            if (draw_size == 0) {
+                printf("Error parsing draws.\n");
+                file.close();
+                return false;
+            }
         }
-        if (str[it] != '\0') ++it;
+        ++n_line;
     }
-    draws[draw_i] = draw;
-    return draw_i + 1;
+
+    file.close();
+    return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -210,47 +257,49 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    File file;
-    if(file.open(argv[1]) == false) {
-        printf("Couldn't read file %s\n", argv[1]);
-        return -1;
-    }
-
     Boards boards;
     boards.init();
 
     unsigned char draws[MAX_DRAWS];
     size_t draw_size = 0;
-    char str[INPUT_MAX];
-    int n_line = 0;
-    while (true) {
-        const int n_read = file.readline(str, INPUT_MAX);
-        if (n_read == 0) break;
 
-        if (n_line > 1 && n_read > 1) {
-            boards.add_row(str);
-        } else if (n_line == 0) {
-            draw_size = parse_draws(str, draws, MAX_DRAWS);
-            if (draw_size == 0) {
-                printf("Error parsing draws.\n");
-                return -1;
-            }
-        }
-        ++n_line;
+    profile_begin("load");
+    const bool use_cache = cache_enabled();
+    Cache cache;
+    bool loaded = false;
+    if (use_cache && cache.open(argv[1], CACHE_VERSION)) {
+        loaded = load_cache(cache, boards, draws, draw_size);
+        cache.close();
+        // a sidecar that doesn't fit is parsed again and replaced
+        if (!loaded) printf("Ignoring the cache of %s\n", argv[1]);
+    }
+    if (!loaded) {
+        if (!read_input(argv[1], boards, draws, draw_size)) return -1;
+        if (use_cache) save_cache(argv[1], boards, draws, draw_size);
     }
+    profile_end();
 
     uint answer1;
     uint answer2;
+    profile_begin("solve");
     if(!boards.bingo_all_boards(draws, draw_size, &answer1, &answer2))
         return -1;
+    profile_end();
 
-    file.close();
     boards.destroy();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 4 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
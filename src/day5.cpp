@@ -1,16 +1,29 @@
 #include <assert.h>
 #include <cmath>
+#include <pthread.h>
 #include <stdio.h>
+#include <unistd.h>
 
+#include "bench.h"
 #include "file.h"
+#include "profile.h"
+#include "spsc_queue.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const size_t INPUT_MAX = 32;
 static const size_t GRID_SIDE = 1000;
 
+// inputs this big are parsed on another thread while the grid is marked
+static const off_t PIPELINE_MIN_SIZE = 1 << 20;
+static const size_t VENT_BATCH = 256;
+static const size_t VENT_QUEUE_SIZE = 1 << 14;
+
 enum LINE_TYPE { DIAGONAL, NOT_DIAGONAL };
 
+typedef struct Vent {
+    int16_t x1, y1, x2, y2;
+} Vent;
+
 // We keep an array of all positions on grid containing the
 // number of vents at that position.
 // To avoid running the problem twice to provide answers
@@ -19,7 +32,7 @@ enum LINE_TYPE { DIAGONAL, NOT_DIAGONAL };
 typedef struct Grid {
     void init(const size_t size);
     void destroy();
-    bool add_vents(const char* str);
+    bool add_vents(const Vent& vent);
     uint overlap_count(const LINE_TYPE type) const;
     void set_straight(const uint x, const uint y);
     void set_diagonal(const uint x, const uint y);
@@ -100,33 +113,25 @@ uint Grid::overlap_count(const LINE_TYPE type = NOT_DIAGONAL) const {
 // We expect a line in the form of:
 // x1,y1 -> x2,y2
 // 800,363 -> 800,25
-bool Grid::add_vents(const char* str) {
-    size_t it = 0;
-    uint value = 0;
+static bool parse_vent(const LineView& line, Vent& vent) {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
 
-    // x1, y2, x1, y2;
-    int points[4];
-    size_t points_i = 0;
-    // parse and extract the values
-    while (str[it] != '\0') {
-        if ((it > 0 && str[it-1] == ',') ||
-            (it > 0 && str[it] == ' ' && str[it+1] == '-')) {
-            points[points_i++] = value;
-            if (points_i == 4) return false;
-            value = 0;
-        }
-        if (ascii_isdigit(str[it])) {
-            const char c = str[it] - '0';
-            value *= 10;
-            if (value >= GRID_SIDE) return false;
-            value += c;
-        }
-        ++it;
+    int16_t* points[4] = { &vent.x1, &vent.y1, &vent.x2, &vent.y2 };
+    for (size_t i = 0; i < 4; ++i) {
+        // skip the ',' and " -> " in between
+        while (i > 0 && it < end && !ascii_isdigit(*it)) ++it;
+        uint32_t value;
+        if (parse_uint32(it, end, value) != INT_OK || value >= GRID_SIDE) return false;
+        *points[i] = value;
     }
-    points[points_i++] = value;
+    // more than 4 values, bail out
+    return it == end;
+}
 
-    // didn't get 4 values, bail out
-    if (points_i != 4) return false;
+bool Grid::add_vents(const Vent& vent) {
+    // x1, y2, x1, y2;
+    const int points[4] = { vent.x1, vent.y1, vent.x2, vent.y2 };
 
     // we have a diagonal if one of the axis is not constant
     if (points[0] != points[2] && points[1] != points[3]) {
@@ -176,7 +181,54 @@ bool Grid::add_vents(const char* str) {
     return true;
 }
 
-int main(int argc, char **argv)
+typedef struct Pipeline {
+    File* file;
+    SpscQueue<Vent> queue;
+} Pipeline;
+
+// producer, bad lines are skipped like add_vents would
+static void* parse_vents(void* arg) {
+    Pipeline& pipeline = *(Pipeline*) arg;
+    Vent batch[VENT_BATCH];
+    size_t n = 0;
+
+    LineView line;
+    while (pipeline.file->next_line(line)) {
+        if (!parse_vent(line, batch[n])) continue;
+        if (++n == VENT_BATCH) {
+            pipeline.queue.push_all(batch, n);
+            n = 0;
+        }
+    }
+    pipeline.queue.push_all(batch, n);
+    pipeline.queue.close();
+    return NULL;
+}
+
+// parse and mark on two threads, false if we couldn't start
+static bool pipeline_vents(File& file, Grid& grid) {
+    Pipeline pipeline;
+    pipeline.file = &file;
+    if (!pipeline.queue.init(VENT_QUEUE_SIZE)) return false;
+
+    pthread_t producer;
+    if (pthread_create(&producer, NULL, parse_vents, &pipeline) != 0) {
+        pipeline.queue.destroy();
+        return false;
+    }
+
+    Vent batch[VENT_BATCH];
+    size_t n;
+    while ((n = pipeline.queue.pop_wait(batch, VENT_BATCH)) > 0) {
+        for (size_t i = 0; i < n; ++i) grid.add_vents(batch[i]);
+    }
+
+    pthread_join(producer, NULL);
+    pipeline.queue.destroy();
+    return true;
+}
+
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -186,21 +238,28 @@ int main(int argc, char **argv)
     }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
+    profile_begin("parse_mark");
     Grid grid;
     grid.init(GRID_SIDE*GRID_SIDE);
 
-    char str[INPUT_MAX];
-    while (true) {
-        const int n_read = file.readline(str, INPUT_MAX);
-        if (n_read == 0) break;
-        grid.add_vents(str);
+    // not worth a thread on small inputs or a single core
+    const bool pipeline = file.size() >= PIPELINE_MIN_SIZE && sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    if (!pipeline || !pipeline_vents(file, grid)) {
+        LineView line;
+        Vent vent;
+        while (file.next_line(line)) {
+            if (parse_vent(line, vent)) grid.add_vents(vent);
+        }
     }
 
+    profile_end();
     const uint answer1 = grid.overlap_count(NOT_DIAGONAL);
     const uint answer2 = grid.overlap_count(DIAGONAL);
 
@@ -211,6 +270,14 @@ int main(int argc, char **argv)
     printf("Day 5 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,18 +1,21 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include "bench.h"
+#include "csv.h"
 #include "file.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const size_t INPUT_MAX = 724;
 static const uint8_t GESTATION_LENGTH = 8;
 static const uint8_t ITER_PART_ONE = 80;
 static const uint8_t ITER_PART_TWO = 256 - ITER_PART_ONE; // we process part one first
+static const size_t FISH_BATCH = 4096;
 
 typedef struct Gestation {
     void init();
-    bool phil_fish(const char* str);
+    bool phil_fish(const LineView& line);
     void iter(const uint8_t days);
     uint64_t fish_count() const;
 
@@ -52,28 +55,24 @@ uint64_t Gestation::fish_count() const {
 
 // We expect a line in the form of:
 // 3,4,3,1,2
-// This won't work if we have numbers with more than 1 digit
-bool Gestation::phil_fish(const char* str) {
-    size_t it = 0;
-    uint8_t value = 0;
-    // BETTER, instead of reading each byte one be one,
-    // we could read WORDS and split them in digit/comma pairs
-    // since we know we'll always be reading the same width
-    while (str[it] != '\0') {
-        if (it > 0 && str[it-1] == ',') {
-            _days[value] += 1;
+// decoded a batch at a time, the line can be megabytes long
+bool Gestation::phil_fish(const LineView& line) {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    uint8_t values[FISH_BATCH];
+    while (true) {
+        size_t count;
+        const CsvStatus status = decode_csv(it, end, values, FISH_BATCH, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (values[i] >= GESTATION_LENGTH) return false;
+            _days[values[i]] += 1;
         }
-        if (ascii_isdigit(str[it])) {
-            value = str[it] - '0';
-            if (value >= GESTATION_LENGTH) return false;
-        }
-        ++it;
+        if (status == CSV_OK) return true;
+        if (status != CSV_FULL) return false;
     }
-    _days[value] += 1;
-    return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -83,26 +82,34 @@ int main(int argc, char **argv)
     }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
+    profile_begin("parse");
     Gestation gestation;
     gestation.init();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!gestation.phil_fish(str)) {
+    LineView line;
+    while (file.next_line(line)) {
+        if (!gestation.phil_fish(line)) {
             printf("Input parsing error.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("part1");
     gestation.iter(ITER_PART_ONE);
     const uint64_t answer1 = gestation.fish_count();
+    profile_end();
+    profile_begin("part2");
     gestation.iter(ITER_PART_TWO);
     const uint64_t answer2 = gestation.fish_count();
+    profile_end();
 
     file.close();
 
@@ -110,6 +117,14 @@ int main(int argc, char **argv)
     printf("Day 6 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %" PRIu64"\n", answer1);
     printf("Answer 2 = %" PRIu64"\n", answer2);
+    report_answer("%" PRIu64, answer1);
+    report_answer("%" PRIu64, answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
@@ -1,38 +1,57 @@
 #include <cmath>
 #include <stdio.h>
 
+#include "bench.h"
+#include "cpu.h"
 #include "bitset.h"
+#include "csv.h"
 #include "file.h"
-#include "radix.h"
+#include "profile.h"
+#include "radix_sort.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const size_t INPUT_MAX = 4000;
-static const uint16_t MAX_CRABS = 1000;
-
 typedef struct Crabs {
     void init();
-    bool fill_crab(const char* str);
-    uint32_t cost(const int16_t point) const;
-    uint32_t cost_two(const int16_t point) const;
-    void sort();
-    uint16_t median() const;
+    void destroy();
+    bool fill_crab(const LineView& line);
+    uint64_t cost(const int16_t point) const;
+    uint64_t cost_two(const int16_t point) const;
+    size_t count() const { return _n_crabs; }
+    uint16_t median();
     void mean(uint16_t* out_ceiling, uint16_t* out_floor) const;
 
 private:
-    uint16_t _crabs[MAX_CRABS];
-    uint16_t _n_crabs;
+    bool reserve(const size_t capacity);
+    uint16_t* _crabs;
+    size_t _n_crabs;
+    size_t _capacity;
 
 } Crabs;
 
 void Crabs::init() {
+    _crabs = NULL;
     _n_crabs = 0;
+    _capacity = 0;
+}
+
+void Crabs::destroy() {
+    free(_crabs);
+}
+
+bool Crabs::reserve(const size_t capacity) {
+    if (capacity <= _capacity) return true;
+    uint16_t* crabs = (uint16_t*) realloc(_crabs, capacity * sizeof(uint16_t));
+    if (crabs == NULL) return false;
+    _crabs = crabs;
+    _capacity = capacity;
+    return true;
 }
 
 // Part 2's answer is always ceiling or floor of the mean
 // BETTER, can we be sure when to use which?
 void Crabs::mean(uint16_t* out_ceiling, uint16_t* out_floor) const {
-    uint32_t sum = 0; 
+    uint64_t sum = 0;
     for (size_t i = 0; i < _n_crabs; ++i) {
         sum += _crabs[i];
     }
@@ -40,60 +59,51 @@ void Crabs::mean(uint16_t* out_ceiling, uint16_t* out_floor) const {
     *out_ceiling = *out_floor + 1;
 }
 
-uint16_t Crabs::median() const {
-    const uint16_t half = _n_crabs >> 1;
-    if (BIT_CHECK(_n_crabs, 0) == 0) return (_crabs[half] + _crabs[half - 1]) / 2;
-    else return _crabs[half];
-}
-
-// this is much faster than std::sort here
-void Crabs::sort() {
-    radix_sort(_crabs, _n_crabs);
+// only the middle crabs are needed, no need to sort them all,
+// radix_select moves crabs around but keeps them all
+uint16_t Crabs::median() {
+    PROFILE("select");
+    const size_t half = _n_crabs >> 1;
+    const uint16_t upper = radix_select(_crabs, _n_crabs, half);
+    if (BIT_CHECK(_n_crabs, 0) == 0) return (upper + radix_select(_crabs, _n_crabs, half - 1)) / 2;
+    else return upper;
 }
 
 // We expect a line in the form of:
 // 16,1,2,0,4,2,7,1,2,14
-bool Crabs::fill_crab(const char* str) {
-    size_t it = 0;
-    uint16_t value = 0;
-    while (str[it] != '\0') {
-        if (it > 0 && str[it-1] == ',') {
-            _crabs[_n_crabs] = value;
-            if ((++_n_crabs) >= MAX_CRABS) return false;
-            value = 0;
-        }
-        if (ascii_isdigit(str[it])) {
-            const char c = str[it] - '0';
-            value *= 10; // this can overflow
-            value += c;
-        }
-        ++it;
-    }
-    _crabs[_n_crabs] = value;
-    _n_crabs++;
-    return true;
+// Inputs can be millions of crabs on that line,
+// count them first to only allocate once.
+bool Crabs::fill_crab(const LineView& line) {
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    if (!reserve(_n_crabs + count_byte(it, end, ',') + 1)) return false;
+
+    size_t count;
+    const CsvStatus status = decode_csv(it, end, _crabs + _n_crabs, _capacity - _n_crabs, count);
+    _n_crabs += count;
+    return status == CSV_OK;
 }
 
 // the overhead of caching the result is slower than
 // calculating it each time with the provided input
-uint32_t Crabs::cost_two(const int16_t point) const {
-    uint32_t cost = 0;
-    for (uint16_t i = 0; i < _n_crabs; ++i) {
-        const uint16_t n_steps = abs(_crabs[i] - point);
+CPU_CLONES uint64_t Crabs::cost_two(const int16_t point) const {
+    uint64_t cost = 0;
+    for (size_t i = 0; i < _n_crabs; ++i) {
+        const uint64_t n_steps = abs(_crabs[i] - point);
         cost += (n_steps+1) * n_steps / 2;
     }
     return cost;
 }
 
-uint32_t Crabs::cost(const int16_t point) const {
-    uint32_t cost = 0;
-    for (uint16_t i = 0; i < _n_crabs; ++i) {
+CPU_CLONES uint64_t Crabs::cost(const int16_t point) const {
+    uint64_t cost = 0;
+    for (size_t i = 0; i < _n_crabs; ++i) {
         cost += abs(_crabs[i] - point);
     }
     return cost;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -103,38 +113,58 @@ int main(int argc, char **argv)
     }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
     Crabs crabs;
     crabs.init();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!crabs.fill_crab(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!crabs.fill_crab(line)) {
             printf("Error parsing input.\n");
             return -1;
         }
     }
-    crabs.sort();
+    profile_end();
+    if (crabs.count() == 0) {
+        printf("No crabs!\n");
+        return -1;
+    }
 
+    profile_begin("part1");
     const uint16_t median = crabs.median();
-    const uint32_t answer1 = crabs.cost(median);
+    const uint64_t answer1 = crabs.cost(median);
+    profile_end();
 
+    profile_begin("part2");
     uint16_t mean_ceiling, mean_floor;
     crabs.mean(&mean_ceiling, &mean_floor);
-    const uint32_t cost_ceiling = crabs.cost_two(mean_floor);
-    const uint32_t cost_floor = crabs.cost_two(mean_floor);
-    const uint32_t answer2 = cost_floor < cost_ceiling? cost_floor : cost_ceiling;
+    const uint64_t cost_ceiling = crabs.cost_two(mean_floor);
+    const uint64_t cost_floor = crabs.cost_two(mean_floor);
+    const uint64_t answer2 = cost_floor < cost_ceiling? cost_floor : cost_ceiling;
+    profile_end();
 
     file.close();
+    crabs.destroy();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 7 completion time: %" PRIu64 "µs\n", completion_time);
-    printf("Answer 1 = %u\n", answer1);
-    printf("Answer 2 = %u\n", answer2);
+    printf("Answer 1 = %" PRIu64 "\n", answer1);
+    printf("Answer 2 = %" PRIu64 "\n", answer2);
+    report_answer("%" PRIu64, answer1);
+    report_answer("%" PRIu64, answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
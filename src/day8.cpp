@@ -1,32 +1,36 @@
-#include <cmath>
 #include <stdio.h>
 #include <string.h>
 
+#include "bench.h"
 #include "file.h"
+#include "parallel.h"
+#include "profile.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 128;
 static const uint8_t MAX_PATTERNS = 10;
 static const uint8_t N_DIGITS = 10;
 static const uint8_t N_OUTPUT = 4;
 static const uint8_t VAL_LENGTH = 7 + 1; // extra for \0
 static const uint8_t KEY_OFFSET = 97;
 
+const uint16_t powers_of_ten[N_OUTPUT] = { 1, 10, 100, 1000 };
 const uint8_t segments_for_digit[N_DIGITS] = { 6, 2, 5, 5, 4, 5, 6, 3, 7, 6 };
 
 typedef struct Segments {
-    bool process_input(const char* str);
+    bool process_input(const LineView& line);
     void init();
-    uint16_t unique_segment() const { return _n_unique_segments; }
-    uint32_t sum_outputs() const { return _sum_outputs; }
+    void merge(const Segments& other);
+    uint64_t unique_segment() const { return _n_unique_segments; }
+    uint64_t sum_outputs() const { return _sum_outputs; }
 
 private:
     void check_unique_segments(const uint8_t size);
     void solve(const char output[N_OUTPUT][VAL_LENGTH]);
     void set_key(const char patterns[MAX_PATTERNS][VAL_LENGTH]);
-    uint16_t _n_unique_segments;
-    uint32_t _sum_outputs;
+    // wide enough for inputs of millions of entries
+    uint64_t _n_unique_segments;
+    uint64_t _sum_outputs;
     uint8_t _key[7];
 
 } Segments;
@@ -37,6 +41,11 @@ void Segments::init() {
     memset(_key, 0, sizeof(uint8_t)*7);
 }
 
+void Segments::merge(const Segments& other) {
+    _n_unique_segments += other._n_unique_segments;
+    _sum_outputs += other._sum_outputs;
+}
+
 static int ascii_is_signal(const int c) {
     return ((c >= 'a' && c <= 'g')? 1 : 0);
 }
@@ -75,7 +84,7 @@ void Segments::solve(const char output[N_OUTPUT][VAL_LENGTH]) {
             case 49: d = 8; break;
             case 45: d = 9; break;
         }
-        _sum_outputs += d * pow(10, (4-i));
+        _sum_outputs += d * powers_of_ten[4-i];
     }
 }
 
@@ -88,21 +97,22 @@ void Segments::check_unique_segments(const uint8_t size) {
 
 // We expect a line in the form of:
 // acedgfb cdfbe gcdfa fbcad dab cefabd cdfgeb eafb cagedb ab | cdfeb fcadb cdfeb cdbaf
-bool Segments::process_input(const char* str) {
+bool Segments::process_input(const LineView& line) {
+    const char* str = line.str;
     size_t str_it = 0;
     uint8_t it_pattern = 0;
     uint8_t it_fill = 0;
     char patterns[MAX_PATTERNS][VAL_LENGTH];
 
     // fill the 10 signal patterns
-    while (str[str_it] != '\0') {
+    while (str_it < line.size) {
         if (ascii_is_signal(str[str_it])) {
             patterns[it_pattern][it_fill] = str[str_it];
             if ((++it_fill) >= VAL_LENGTH) return false;
-        } else if (str[str_it] == ' ' && str[str_it-1] != '|') {
+        } else if (str[str_it] == ' ' && str_it > 0 && str[str_it-1] != '|') {
             patterns[it_pattern][it_fill] = '\0';
             ++it_pattern;
-            if (str[str_it+1] != '|' && it_pattern >= MAX_PATTERNS) return false;
+            if (str_it + 1 < line.size && str[str_it+1] != '|' && it_pattern >= MAX_PATTERNS) return false;
             it_fill = 0;
         } else if (str[str_it] == '|') {
             ++str_it;
@@ -117,7 +127,7 @@ bool Segments::process_input(const char* str) {
     it_fill = 0;
 
     // fill the 4 output values
-    while (str[str_it] != '\0') {
+    while (str_it < line.size) {
         if (ascii_is_signal(str[str_it])) {
             output[it_pattern][it_fill] = str[str_it];
             if ((++it_fill) >= VAL_LENGTH) return false;
@@ -135,7 +145,14 @@ bool Segments::process_input(const char* str) {
     return true;
 }
 
-int main(int argc, char **argv)
+// each line is independent, every thread counts in its own Segments
+static bool parse_entry(const LineView& line, const size_t index, void* local, void* user) {
+    (void) index;
+    (void) user;
+    return ((Segments*) local)->process_input(line);
+}
+
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -144,32 +161,75 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    File file;
-    if(file.open(argv[1]) == false) {
-        printf("Couldn't read file %s\n", argv[1]);
-        return -1;
-    }
+    Segments patterns[PARALLEL_MAX_THREADS];
+    size_t n_threads;
+    if (parse_loads_whole(argv[1])) {
+        File file;
+        profile_begin("read");
+        if(file.open(argv[1]) == false) {
+            printf("Couldn't read file %s\n", argv[1]);
+            return -1;
+        }
+        profile_end();
 
-    Segments patterns;
-    patterns.init();
+        profile_begin("index");
+        Lines lines;
+        if (!lines.init(file)) {
+            printf("Couldn't index file %s\n", argv[1]);
+            return -1;
+        }
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!patterns.process_input(str)) {
+        profile_end();
+        profile_begin("parse");
+        n_threads = parse_threads(lines);
+        for (size_t i = 0; i < n_threads; ++i) patterns[i].init();
+        if (!parse_lines(lines, n_threads, parse_entry, patterns, sizeof(Segments), NULL)) {
             printf("error with input.\n");
             return -1;
         }
-    }
+        profile_end();
+        lines.destroy();
+        file.close();
+    } else {
+        // pipes, stdin and huge files, in constant memory
+        Stream stream;
+        if(stream.open(argv[1]) == false) {
+            printf("Couldn't read file %s\n", argv[1]);
+            return -1;
+        }
 
-    const uint16_t answer1 = patterns.unique_segment();
-    const uint32_t answer2 = patterns.sum_outputs();
+        profile_begin("parse");
+        n_threads = parse_stream_threads();
+        for (size_t i = 0; i < n_threads; ++i) patterns[i].init();
+        const bool ok = parse_stream(stream, n_threads, parse_entry, patterns, sizeof(Segments), NULL);
+        profile_end();
+        const bool failed = stream.failed();
+        stream.close();
+        if (!ok) {
+            if (failed) printf("Couldn't read file %s\n", argv[1]);
+            else printf("error with input.\n");
+            return -1;
+        }
+    }
 
-    file.close();
+    profile_begin("solve");
+    for (size_t i = 1; i < n_threads; ++i) patterns[0].merge(patterns[i]);
+    const uint64_t answer1 = patterns[0].unique_segment();
+    const uint64_t answer2 = patterns[0].sum_outputs();
+    profile_end();
 
     const uint64_t completion_time = timer_stop();
     printf("Day 8 completion time: %" PRIu64 "µs\n", completion_time);
-    printf("Answer 1 = %u\n", answer1);
-    printf("Answer 2 = %u\n", answer2);
+    printf("Answer 1 = %" PRIu64 "\n", answer1);
+    printf("Answer 2 = %" PRIu64 "\n", answer2);
+    report_answer("%" PRIu64, answer1);
+    report_answer("%" PRIu64, answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
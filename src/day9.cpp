@@ -1,11 +1,12 @@
 #include <stdio.h>
 
+#include "bench.h"
 #include "file.h"
+#include "profile.h"
 #include "stack.h"
 #include "strtoint.h"
 #include "timer.h"
 
-static const uint8_t INPUT_MAX = 128;
 static const uint8_t MAX_ROW = 100;
 static const uint8_t N_COL = 100;
 static const uint8_t MAX_POINTS = 0xFF;
@@ -15,11 +16,11 @@ typedef struct Pos {
 } Pos;
 
 typedef struct Heightmap {
-    void init();
+    bool init();
     void destroy();
     uint16_t low_points_risk();
-    uint32_t largest_basins();
-    bool add_row(const char* str);
+    bool largest_basins(uint32_t* result);
+    bool add_row(const LineView& line);
 
 private:
     Pos _low_points[MAX_POINTS];
@@ -34,13 +35,15 @@ void Heightmap::destroy() {
     _stack.destroy();
 }
 
-void Heightmap::init() {
+bool Heightmap::init() {
     _n_row = 0;
     _n_lows = 0;
-    _stack.init(32);
+    return _stack.init(32);
 }
 
-uint32_t Heightmap::largest_basins() {
+// false if the stack couldn't grow
+bool Heightmap::largest_basins(uint32_t* result) {
+    bool ok = true;
     uint16_t a = 0;
     uint16_t b = 0;
     uint16_t c = 0;
@@ -49,7 +52,7 @@ uint32_t Heightmap::largest_basins() {
         _stack.clear();
         // we set to 9 to mark visited
         _map[_low_points[i].y][_low_points[i].x] = 9;
-        _stack.push(std::move(_low_points[i]));
+        ok &= _stack.push(std::move(_low_points[i]));
 
         // visit neighbours as long as they are not 9
         Pos visiting;
@@ -59,7 +62,7 @@ uint32_t Heightmap::largest_basins() {
                 to_visit.x = visiting.x-1;
                 to_visit.y = visiting.y;
                 _map[to_visit.y][to_visit.x] = 9;
-                _stack.push(std::move(to_visit));
+                ok &= _stack.push(std::move(to_visit));
                 basin_size += 1;
             }
             if (visiting.y != 0 && 9 != _map[visiting.y-1][visiting.x]) {
@@ -67,7 +70,7 @@ uint32_t Heightmap::largest_basins() {
                 to_visit.x = visiting.x;
                 to_visit.y = visiting.y-1;
                 _map[to_visit.y][to_visit.x] = 9;
-                _stack.push(std::move(to_visit));
+                ok &= _stack.push(std::move(to_visit));
                 basin_size += 1;
             }
             if (visiting.x < N_COL - 1 && 9 != _map[visiting.y][visiting.x+1]) {
@@ -75,7 +78,7 @@ uint32_t Heightmap::largest_basins() {
                 to_visit.x = visiting.x+1;
                 to_visit.y = visiting.y;
                 _map[to_visit.y][to_visit.x] = 9;
-                _stack.push(std::move(to_visit));
+                ok &= _stack.push(std::move(to_visit));
                 basin_size += 1;
             }
             if (visiting.y < _n_row - 1 && 9 != _map[visiting.y+1][visiting.x]) {
@@ -83,10 +86,11 @@ uint32_t Heightmap::largest_basins() {
                 to_visit.x = visiting.x;
                 to_visit.y = visiting.y+1;
                 _map[to_visit.y][to_visit.x] = 9;
-                _stack.push(std::move(to_visit));
+                ok &= _stack.push(std::move(to_visit));
                 basin_size += 1;
             }
         }
+        if (!ok) return false;
         // BETTER, got to be a better way
         if(basin_size > a) {
             c = b;
@@ -99,7 +103,8 @@ uint32_t Heightmap::largest_basins() {
             c = basin_size;
         }
     }
-    return a * b * c;
+    *result = a * b * c;
+    return true;
 }
 
 uint16_t Heightmap::low_points_risk() {
@@ -133,21 +138,19 @@ uint16_t Heightmap::low_points_risk() {
 
 // simple row of digits:
 // 2199943210
-bool Heightmap::add_row(const char* str) {
-    uint8_t it = 0;
+bool Heightmap::add_row(const LineView& line) {
     if (_n_row >= MAX_ROW) return false;
-    while (str[it] != '\0') {
-        if (ascii_isdigit(str[it])) {
+    for (size_t it = 0; it < line.size; ++it) {
+        if (ascii_isdigit(line.str[it])) {
             if (it >= N_COL) return false;
-            _map[_n_row][it] = str[it] - '0';
+            _map[_n_row][it] = line.str[it] - '0';
         }
-        ++it;
     }
     _n_row++;
     return true;
 }
 
-int main(int argc, char **argv)
+static int run(int argc, char **argv)
 {
     timer_start();
 
@@ -157,24 +160,39 @@ int main(int argc, char **argv)
     }
 
     Heightmap height_map;
-    height_map.init();
+    if (!height_map.init()) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
 
     File file;
+    profile_begin("read");
     if(file.open(argv[1]) == false) {
         printf("Couldn't read file %s\n", argv[1]);
         return -1;
     }
+    profile_end();
 
-    char str[INPUT_MAX];
-    while (file.readline(str, INPUT_MAX)) {
-        if (!height_map.add_row(str)) {
+    profile_begin("parse");
+    LineView line;
+    while (file.next_line(line)) {
+        if (!height_map.add_row(line)) {
             printf("Error with input.\n");
             return -1;
         }
     }
 
+    profile_end();
+    profile_begin("part1");
     const uint16_t answer1 = height_map.low_points_risk();
-    const uint32_t answer2 = height_map.largest_basins();
+    profile_end();
+    profile_begin("part2");
+    uint32_t answer2 = 0;
+    if (!height_map.largest_basins(&answer2)) {
+        printf("Couldn't allocate.\n");
+        return -1;
+    }
+    profile_end();
 
     file.close();
     height_map.destroy();
@@ -183,6 +201,14 @@ int main(int argc, char **argv)
     printf("Day 9 completion time: %" PRIu64 "µs\n", completion_time);
     printf("Answer 1 = %u\n", answer1);
     printf("Answer 2 = %u\n", answer2);
+    report_answer("%u", answer1);
+    report_answer("%u", answer2);
 
+    profile_report();
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, run);
+}
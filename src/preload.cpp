@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#include "file.h"
+#include "timer.h"
+
+// Pull every input given in parameter into the page cache in one go,
+// so the days run after it don't each wait on the disk in turn.
+
+static void ready(const size_t index, File& file, void* user) {
+    (void) index;
+    *(off_t*) user += file.size();
+    file.close();
+}
+
+int main(int argc, char **argv)
+{
+    timer_start();
+
+    const size_t n = argc - 1;
+    File* files = (File*) malloc(n * sizeof(File));
+    if (n > 0 && files == NULL) return -1;
+
+    off_t total = 0;
+    const size_t n_loaded = open_files(argv + 1, n, files, ready, &total);
+    free(files);
+
+    const uint64_t completion_time = timer_stop();
+    printf("Preloaded %zu/%zu inputs, %" PRIu64 " bytes in %" PRIu64 "µs\n",
+           n_loaded, n, (uint64_t) total, completion_time);
+
+    return 0;
+}
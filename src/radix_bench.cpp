@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "radix_parallel.h"
+#include "timer.h"
+
+// Time radix_sort_parallel from 1 thread up to all cores.
+// usage: radix_bench [count] [max threads]
+
+static const size_t BENCH_COUNT = 20000000;
+static const uint8_t BENCH_RUNS = 3;
+
+// xorshift, we only need something that doesn't sort itself
+static uint64_t next_random(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+template <typename T>
+static void bench(const char* name, const size_t count, const size_t max_threads) {
+    T* input = (T*) malloc(count * sizeof(T));
+    T* a = (T*) malloc(count * sizeof(T));
+    T* scratch = (T*) malloc(count * sizeof(T));
+    if (input == NULL || a == NULL || scratch == NULL) {
+        printf("Not enough memory for %zu keys\n", count);
+        goto beach;
+    }
+
+    {
+        uint64_t state = 0x9E3779B97F4A7C15;
+        for (size_t i = 0; i < count; ++i) input[i] = (T) next_random(state);
+
+        // 0 threads is the serial sort, the reference for speedups
+        size_t steps[RADIX_MAX_THREADS + 2];
+        size_t n_steps = 0;
+        steps[n_steps++] = 0;
+        for (size_t threads = 1; threads < max_threads; threads *= 2) steps[n_steps++] = threads;
+        steps[n_steps++] = max_threads;
+
+        uint64_t serial = 0;
+        for (size_t step = 0; step < n_steps; ++step) {
+            const size_t threads = steps[step];
+            // best of a few runs
+            uint64_t best = UINT64_MAX;
+            for (uint8_t run = 0; run < BENCH_RUNS; ++run) {
+                memcpy(a, input, count * sizeof(T));
+                timer_start();
+                if (threads == 0) radix_sort(a, count, scratch);
+                else radix_sort_parallel(a, count, scratch, threads, 0);
+                const uint64_t time = timer_stop();
+                if (time < best) best = time;
+            }
+            for (size_t i = 1; i < count; ++i) {
+                if (a[i - 1] > a[i]) {
+                    printf("%s not sorted with %zu threads\n", name, threads);
+                    goto beach;
+                }
+            }
+
+            if (threads == 0) {
+                serial = best;
+                printf("%-8s %10zu keys  serial      %8" PRIu64 "µs\n", name, count, best);
+            } else {
+                printf("%-8s %10zu keys  %2zu threads  %8" PRIu64 "µs  x%.2f\n", name, count, threads, best,
+                       (double) serial / (best > 0? best : 1));
+            }
+        }
+    }
+
+beach:
+    free(input);
+    free(a);
+    free(scratch);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t count = (argc > 1)? strtoull(argv[1], NULL, 10) : BENCH_COUNT;
+    const long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = (argc > 2)? strtoull(argv[2], NULL, 10) : (n_cpu > 0)? n_cpu : 1;
+    if (max_threads == 0) max_threads = 1;
+    if (max_threads > RADIX_MAX_THREADS) max_threads = RADIX_MAX_THREADS;
+
+    bench<uint32_t>("uint32_t", count, max_threads);
+    bench<uint64_t>("uint64_t", count, max_threads);
+    bench<int64_t>("int64_t", count, max_threads);
+
+    return 0;
+}
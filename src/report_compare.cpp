@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+
+// Check a run against a baseline, both CSV records from AOC_REPORT=csv.
+// usage: report_compare baseline.csv current.csv [threshold %] [noise µs]
+// A phase regresses when it's threshold % slower than in the baseline
+// (10 by default) and by more than the noise (50µs by default), for the
+// same day on the same input. The total of a day compares medians,
+// phases compare their time per call. Answers that changed on the same
+// input fail too. Returns 1 on any failure, so scripts can gate on it.
+
+static const size_t COMPARE_FIELD_SIZE = 256;
+static const size_t COMPARE_MIN_FIELDS = 8;
+static const double COMPARE_THRESHOLD = 10.0;
+static const double COMPARE_NOISE_US = 50.0;
+
+enum Column { COL_DAY = 0, COL_HASH, COL_ANSWERS, COL_PHASE, COL_CALLS, COL_NS_PER_CALL, COL_MIN, COL_MEDIAN };
+
+typedef struct Row {
+    char day[COMPARE_FIELD_SIZE];
+    char hash[COMPARE_FIELD_SIZE];
+    char answers[COMPARE_FIELD_SIZE];
+    char phase[COMPARE_FIELD_SIZE];
+    double ns;
+} Row;
+
+typedef struct Rows {
+    void init();
+    void destroy();
+    bool load(const char* path);
+    const Row* find(const Row& row) const;
+    size_t count() const { return _n_rows; }
+    const Row& row(const size_t i) const { return _rows[i]; }
+
+private:
+    bool add(const LineView& line);
+    Row* _rows;
+    size_t _n_rows;
+    size_t _capacity;
+} Rows;
+
+void Rows::init() {
+    _rows = NULL;
+    _n_rows = 0;
+    _capacity = 0;
+}
+
+void Rows::destroy() {
+    free(_rows);
+}
+
+// one field, quoted or not, moves it past the comma
+static bool read_field(const char*& it, const char* end, char* out) {
+    size_t size = 0;
+    const bool quoted = (it < end && *it == '"');
+    if (quoted) ++it;
+    while (it < end) {
+        if (quoted && *it == '"') {
+            // "" is a quote inside the field
+            if (it + 1 < end && it[1] == '"') {
+                ++it;
+            } else {
+                ++it;
+                break;
+            }
+        } else if (!quoted && *it == ',') {
+            break;
+        }
+        if (size + 1 == COMPARE_FIELD_SIZE) return false;
+        out[size++] = *it++;
+    }
+    out[size] = '\0';
+    if (it < end && *it != ',') return false;
+    if (it < end) ++it;
+    return true;
+}
+
+bool Rows::add(const LineView& line) {
+    if (_n_rows == _capacity) {
+        const size_t capacity = (_capacity == 0)? 64 : _capacity * 2;
+        Row* rows = (Row*) realloc(_rows, capacity * sizeof(Row));
+        if (rows == NULL) return false;
+        _rows = rows;
+        _capacity = capacity;
+    }
+
+    Row& row = _rows[_n_rows];
+    row.ns = 0;
+    const char* it = line.str;
+    const char* end = line.str + line.size;
+    char field[COMPARE_FIELD_SIZE];
+    char calls[COMPARE_FIELD_SIZE];
+    size_t n_fields = 0;
+    while (it < end && n_fields <= COL_MEDIAN) {
+        char* out = field;
+        switch (n_fields) {
+            case COL_DAY: out = row.day; break;
+            case COL_HASH: out = row.hash; break;
+            case COL_ANSWERS: out = row.answers; break;
+            case COL_PHASE: out = row.phase; break;
+            case COL_CALLS: out = calls; break;
+            default: break;
+        }
+        if (!read_field(it, end, out)) return false;
+        if (n_fields == COL_NS_PER_CALL && strcmp(row.phase, "total") != 0) row.ns = atof(field);
+        if (n_fields == COL_MEDIAN && strcmp(row.phase, "total") == 0) row.ns = atof(field);
+        ++n_fields;
+    }
+    if (n_fields < COMPARE_MIN_FIELDS) return false;
+
+    ++_n_rows;
+    return true;
+}
+
+// skips the header
+bool Rows::load(const char* path) {
+    File file;
+    if (!file.open(path)) return false;
+
+    LineView line;
+    bool ok = true;
+    while (ok && file.next_line(line)) {
+        if (line.size == 0 || strncmp(line.str, "day,", 4) == 0) continue;
+        ok = add(line);
+    }
+    file.close();
+    return ok;
+}
+
+// the last one wins if a day was run twice
+const Row* Rows::find(const Row& row) const {
+    for (size_t i = _n_rows; i-- > 0;) {
+        const Row& candidate = _rows[i];
+        if (strcmp(candidate.day, row.day) == 0 && strcmp(candidate.phase, row.phase) == 0) return &candidate;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("usage: %s baseline.csv current.csv [threshold %%] [noise µs]\n", argv[0]);
+        return 2;
+    }
+    const double threshold = (argc > 3)? atof(argv[3]) : COMPARE_THRESHOLD;
+    const double noise_ns = ((argc > 4)? atof(argv[4]) : COMPARE_NOISE_US) * 1000.0;
+
+    Rows baseline, current;
+    baseline.init();
+    current.init();
+    if (!baseline.load(argv[1]) || !current.load(argv[2])) {
+        printf("Couldn't read %s or %s\n", argv[1], argv[2]);
+        return 2;
+    }
+
+    size_t n_regressions = 0;
+    size_t n_wrong = 0;
+    printf("%-8s %-24s %14s %14s %8s\n", "day", "phase", "baseline µs", "current µs", "change");
+    for (size_t i = 0; i < current.count(); ++i) {
+        const Row& row = current.row(i);
+        const Row* base = baseline.find(row);
+        if (base == NULL) {
+            printf("%-8s %-24s %14s %14.1f %8s\n", row.day, row.phase, "-", row.ns / 1000.0, "new");
+            continue;
+        }
+        if (strcmp(base->hash, row.hash) != 0) {
+            printf("%-8s %-24s %14s %14s %8s\n", row.day, row.phase, "", "", "input changed");
+            continue;
+        }
+
+        const char* verdict = "";
+        if (strcmp(base->answers, row.answers) != 0) {
+            verdict = "WRONG ANSWER";
+            if (strcmp(row.phase, "total") == 0) ++n_wrong;
+        } else if (row.ns > base->ns * (1.0 + threshold / 100.0) && row.ns - base->ns > noise_ns) {
+            verdict = "REGRESSION";
+            ++n_regressions;
+        }
+        const double change = (base->ns == 0)? 0.0 : 100.0 * (row.ns - base->ns) / base->ns;
+        printf("%-8s %-24s %14.1f %14.1f %+7.1f%% %s\n", row.day, row.phase, base->ns / 1000.0,
+               row.ns / 1000.0, change, verdict);
+    }
+
+    printf("%zu regressions over %.1f%%, %zu days with different answers\n", n_regressions, threshold, n_wrong);
+
+    baseline.destroy();
+    current.destroy();
+    return (n_regressions > 0 || n_wrong > 0)? 1 : 0;
+}